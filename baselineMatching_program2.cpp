@@ -4,106 +4,62 @@ Project 2
   
 Created by Ruohe Zhou and Rucha Pendharkar on 2/8/24
 
-This code is used for Task 1. The code reads the features.csv file and use sum-of-squared-difference
-to find the top 5 similar images.
+This code is used for Task 1. The code maps the features.bin store (imported from features.csv
+on first use) and use sum-of-squared-difference to find the top 5 similar images.
 
 
 **/
 
 #include <opencv2/opencv.hpp>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdlib>
+#include <string>
 #include <vector>
 #include <algorithm>
-
-// Structure to hold image features
-struct ImageFeatures {
-    std::string filename;
-    std::vector<float> features;
-};
-
-// Function to parse features from CSV file
-std::vector<ImageFeatures> parseFeatures(const std::string& filename) {
-    std::vector<ImageFeatures> featuresList;
-
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Unable to open CSV file " << filename << std::endl;
-        return featuresList;
-    }
-
-    std::string line;
-    std::getline(file, line); // Skip header line
-
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string filename;
-        std::getline(iss, filename, ',');
-
-        ImageFeatures imgFeatures;
-        imgFeatures.filename = filename;
-
-        std::string feature;
-        while (std::getline(iss, feature, ',')) {
-            imgFeatures.features.push_back(std::stof(feature));
-        }
-
-        featuresList.push_back(imgFeatures);
-    }
-
-    return featuresList;
-}
-
-// Function to compute similarity score between two feature vectors using sum-of-squared-difference
-float computeSimilarity(const std::vector<float>& features1, const std::vector<float>& features2) {
-    float score = 0.0f;
-    for (size_t i = 0; i < features1.size(); ++i) {
-        score += std::pow(features1[i] - features2[i], 2);
+#include "featureStore.h"
+#include "prunedScan.h"
+#include "topK.h"
+
+int main(int argc, char* argv[]) {
+    // Optional arguments: target filename, number of matches and scan mode
+    std::string targetFilename = argc > 1 ? argv[1] : "pic.1016.jpg";
+    int numMatches = argc > 2 ? std::atoi(argv[2]) : 5;
+    ScanMode scanMode;
+    if (parseScanMode(argc > 3 ? argv[3] : "pruned", scanMode) != 0) {
+        return 1;
     }
-    return score;
-}
 
-int main() {
-    // Load features of all images from CSV file
-    std::vector<ImageFeatures> allFeatures = parseFeatures("../features.csv");
-    if (allFeatures.empty()) {
-        std::cerr << "Error: No features found in CSV file." << std::endl;
+    // Map the feature store, importing it from the CSV file on first use
+    FeatureStore allFeatures;
+    if (loadFeatureStore(allFeatures, "../features.bin", "../features.csv", "orb-center", FS_NORM_NONE) != 0 || allFeatures.size() == 0) {
+        std::cerr << "Error: No features found in feature store." << std::endl;
         return 1;
     }
 
     // Select features of image 1
-    std::vector<float> featuresOfImage1;
-    for (const auto& imgFeatures : allFeatures) {
-        if (imgFeatures.filename == "pic.1016.jpg") {
-            featuresOfImage1 = imgFeatures.features;
-            break;
-        }
-    }
-
-    if (featuresOfImage1.empty()) {
+    long targetIndex = allFeatures.find(targetFilename);
+    if (targetIndex < 0) {
         std::cerr << "Error: Features of image 1 not found." << std::endl;
         return 1;
     }
+    const float* featuresOfImage1 = allFeatures.row(targetIndex);
 
-    // Compute similarity scores between image 1 and all other images
-    std::vector<std::pair<std::string, float>> similarityScores;
-    for (const auto& imgFeatures : allFeatures) {
-        if (imgFeatures.filename != "pic.1016.jpg") {
-            float similarity = computeSimilarity(featuresOfImage1, imgFeatures.features);
-            similarityScores.emplace_back(imgFeatures.filename, similarity);
-        }
+    // Compute similarity scores between image 1 and all other images, keeping the best numMatches.
+    // The pruned scans abandon an image once its partial distance exceeds the current worst match.
+    TopK bestMatches(std::max(numMatches, 0));
+    ScanStats scanStats;
+    if (prunedScan(allFeatures, "../features.bin", featuresOfImage1, PRUNED_SSD, targetIndex, scanMode, bestMatches, &scanStats) != 0) {
+        return 1;
     }
 
-    // Sort images based on similarity scores
-    std::sort(similarityScores.begin(), similarityScores.end(), [](const auto& a, const auto& b) {
-        return a.second < b.second;
-    });
-
-    // Print top 5 similar images
-    std::cout << "Top 5 images similar to image 1:" << std::endl;
-    for (int i = 0; i < 5; ++i) {
-        std::cout << similarityScores[i].first << " - Similarity Score: " << similarityScores[i].second << std::endl;
+    // Print top similar images
+    std::cout << "Top " << numMatches << " images similar to " << targetFilename << ":" << std::endl;
+    for (const auto& match : bestMatches.sorted()) {
+        std::cout << allFeatures.name(match.id) << " - Similarity Score: " << match.score << std::endl;
+    }
+    if ((scanMode == SCAN_PRUNED || scanMode == SCAN_VARIANCE_ORDERED) && scanStats.dimsTotal > 0) {
+        std::cout << "Read " << 100.0 * scanStats.dimsScanned / scanStats.dimsTotal << "% of the feature values, "
+                  << scanStats.abandoned << " of " << scanStats.candidates << " images abandoned early" << std::endl;
     }
 
     return 0;
@@ -0,0 +1,495 @@
+/**
+
+benchmarkSuite.cpp
+Project 2
+
+Benchmark of every stage of the retrieval system on a synthetic image collection.
+The collection (and one feature store per family) is generated reproducibly from
+the options, so two builds run on the same pixels and their timings can be compared.
+Each stage is timed in isolation on data prepared outside the timed region: JPEG
+decoding from memory, every registered feature extractor on decoded images, CSV and
+binary store writing and loading, every distance kernel, top-k selection, the
+matcher scans, pixel k-means and face detection. Two end-to-end stages time a full
+ingest from disk and a full matcher query. Every stage runs --repeat times and the
+results are written as JSON for regression tracking; `make benchmark` runs the suite
+with the defaults.
+
+Usage: benchmarkSuite [--images N] [--size WxH] [--seed S] [--repeat R] [--queries Q]
+                      [--dir path] [--out file.json] [--cascade file]
+
+**/
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "distanceKernels.h"
+#include "faceDetect.h"
+#include "faceDetector.h"
+#include "featureRegistry.h"
+#include "featureStore.h"
+#include "ingestPipeline.h"
+#include "kmeansEngine.h"
+#include "prunedScan.h"
+#include "quantizedStore.h"
+#include "syntheticCollection.h"
+#include "topK.h"
+
+namespace fs = std::filesystem;
+
+// Results are folded into this so the compiler cannot drop the timed work
+static volatile double benchmarkSink = 0.0;
+
+struct StageTiming {
+    std::string name;
+    size_t items;               // work units per run: images, distance pairs, queries
+    std::vector<double> runsMs;
+};
+
+class BenchmarkRecorder {
+public:
+    explicit BenchmarkRecorder(int repeat) : repeat_(std::max(1, repeat)) {}
+
+    // Run stage repeat times and record the wall time of each run
+    template <class Fn>
+    void time(const std::string& name, size_t items, Fn stage) {
+        StageTiming timing{name, items, {}};
+        for (int r = 0; r < repeat_; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            stage();
+            timing.runsMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        double best = *std::min_element(timing.runsMs.begin(), timing.runsMs.end());
+        std::printf("%-28s %10.3f ms  %12.6f ms/item\n", name.c_str(), best, items ? best / items : 0.0);
+        std::fflush(stdout);
+        stages_.push_back(timing);
+    }
+
+    void skip(const std::string& name, const std::string& reason) {
+        std::printf("%-28s skipped: %s\n", name.c_str(), reason.c_str());
+        skipped_.push_back({name, reason});
+    }
+
+    void setConfig(const std::string& key, const std::string& jsonValue) { config_.push_back({key, jsonValue}); }
+
+    int writeJson(const std::string& path) const;
+
+private:
+    int repeat_;
+    std::vector<StageTiming> stages_;
+    std::vector<std::pair<std::string, std::string>> skipped_;
+    std::vector<std::pair<std::string, std::string>> config_;
+};
+
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static std::string jsonNumber(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6f", value);
+    return buffer;
+}
+
+int BenchmarkRecorder::writeJson(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    out << "{\n  \"suite\": \"cbir-benchmark\",\n  \"version\": 1,\n  \"config\": {";
+    for (size_t i = 0; i < config_.size(); ++i) {
+        out << (i ? "," : "") << "\n    " << jsonString(config_[i].first) << ": " << config_[i].second;
+    }
+    out << "\n  },\n  \"stages\": [";
+    for (size_t s = 0; s < stages_.size(); ++s) {
+        const StageTiming& stage = stages_[s];
+        std::vector<double> sorted = stage.runsMs;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = 0.0;
+        for (double ms : sorted) {
+            mean += ms / sorted.size();
+        }
+        out << (s ? "," : "") << "\n    {\"name\": " << jsonString(stage.name) << ", \"items\": " << stage.items
+            << ", \"runs\": " << sorted.size() << ", \"minMs\": " << jsonNumber(sorted.front())
+            << ", \"medianMs\": " << jsonNumber(sorted[sorted.size() / 2]) << ", \"meanMs\": " << jsonNumber(mean)
+            << ", \"maxMs\": " << jsonNumber(sorted.back())
+            << ", \"msPerItem\": " << jsonNumber(stage.items ? sorted.front() / stage.items : 0.0) << "}";
+    }
+    out << "\n  ],\n  \"skipped\": [";
+    for (size_t s = 0; s < skipped_.size(); ++s) {
+        out << (s ? "," : "") << "\n    {\"name\": " << jsonString(skipped_[s].first) << ", \"reason\": " << jsonString(skipped_[s].second) << "}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out) {
+        std::cerr << "Error: Unable to write " << path << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Features of one family for every image, and the store they were written to
+struct FamilyData {
+    const FeatureComputer* computer;
+    std::string storeFile;
+    std::vector<std::vector<float>> features;
+};
+
+static int writeStore(const std::string& storeFile, const FeatureComputer& computer, const std::vector<std::string>& names,
+                      const std::vector<std::vector<float>>& features) {
+    FeatureStoreWriter writer;
+    if (writer.open(storeFile, computer.featureType, computer.normalization) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        writer.append(names[i], features[i]);
+    }
+    return writer.close();
+}
+
+// The CSV layout the per-task extractors write
+static void writeCsv(const std::string& csvFile, const std::vector<std::string>& names, const std::vector<std::vector<float>>& features) {
+    std::ofstream csv(csvFile, std::ios::trunc);
+    csv << "filename,";
+    for (size_t j = 0; j < features[0].size(); ++j) {
+        csv << "feature_" << j << ",";
+    }
+    csv << "\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        csv << names[i] << ",";
+        for (float value : features[i]) {
+            csv << value << ",";
+        }
+        csv << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SyntheticCollectionOptions options;
+    std::string directory = "../benchmark_data";
+    std::string outputFile = "benchmark.json";
+    std::string cascadeFile = FACE_CASCADE_FILE;
+    int repeat = 3;
+    int numQueries = 20;
+    const int k = 10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--images" && i + 1 < argc) {
+            options.count = std::atoi(argv[++i]);
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) {
+                std::cerr << "Error: --size expects WxH, e.g. 640x480" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::atoi(argv[++i]);
+        } else if (arg == "--queries" && i + 1 < argc) {
+            numQueries = std::atoi(argv[++i]);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (arg == "--cascade" && i + 1 < argc) {
+            cascadeFile = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--images N] [--size WxH] [--seed S] [--repeat R] [--queries Q]"
+                      << " [--dir path] [--out file.json] [--cascade file]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Collection, then every image's bytes in memory so decoding is timed without the disk
+    std::string imageDir = (fs::path(directory) / "images").string();
+    std::cout << "Preparing " << options.count << " synthetic images of " << options.width << "x" << options.height << " in " << imageDir << std::endl;
+    if (generateSyntheticCollection(imageDir, options) < 0) {
+        return 1;
+    }
+    std::vector<fs::path> paths;
+    for (const auto& entry : fs::directory_iterator(imageDir)) {
+        if (entry.is_regular_file() && isImageFile(entry.path())) {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    size_t count = paths.size();
+    if (count < 2) {
+        std::cerr << "Error: The benchmark needs at least two images" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> names(count);
+    std::vector<std::vector<uchar>> encoded(count);
+    for (size_t i = 0; i < count; ++i) {
+        names[i] = paths[i].filename().string();
+        std::ifstream file(paths[i], std::ios::binary);
+        encoded[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    numQueries = std::max(1, std::min(numQueries, static_cast<int>(count)));
+    std::vector<size_t> queries;
+    for (int q = 0; q < numQueries; ++q) {
+        queries.push_back(static_cast<size_t>(q) * count / numQueries);
+    }
+
+    BenchmarkRecorder recorder(repeat);
+    recorder.setConfig("images", std::to_string(count));
+    recorder.setConfig("width", std::to_string(options.width));
+    recorder.setConfig("height", std::to_string(options.height));
+    recorder.setConfig("seed", std::to_string(options.seed));
+    recorder.setConfig("repeat", std::to_string(std::max(1, repeat)));
+    recorder.setConfig("queries", std::to_string(numQueries));
+    recorder.setConfig("k", std::to_string(k));
+    recorder.setConfig("simd", jsonString(simdLevelName(detectSimdLevel())));
+    recorder.setConfig("hardwareThreads", std::to_string(std::thread::hardware_concurrency()));
+    recorder.setConfig("opencv", jsonString(CV_VERSION));
+    recorder.setConfig("compiler", jsonString(__VERSION__));
+
+    // Decoding
+    std::vector<cv::Mat> color(count), gray(count);
+    recorder.time("decode.color", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            color[i] = cv::imdecode(encoded[i], cv::IMREAD_COLOR);
+        }
+    });
+    recorder.time("decode.gray", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            gray[i] = cv::imdecode(encoded[i], cv::IMREAD_GRAYSCALE);
+        }
+    });
+    recorder.time("decode.reduced2", count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            benchmarkSink = benchmarkSink + cv::imdecode(encoded[i], cv::IMREAD_REDUCED_COLOR_2).rows;
+        }
+    });
+
+    // Every feature family on the decoded images, including its colour conversions
+    std::vector<FamilyData> families;
+    for (const FeatureComputer& computer : featureComputers()) {
+        if (featureImreadFlag(computer.featureType) < 0) {
+            continue;
+        }
+        FamilyData family{&computer, (fs::path(directory) / (computer.featureType + ".bin")).string(), std::vector<std::vector<float>>(count)};
+        bool ok = true;
+        recorder.time("feature." + computer.featureType, count, [&] {
+            for (size_t i = 0; i < count; ++i) {
+                ImageContext context(computer.needsColor ? color[i] : gray[i]);
+                ok = computer.compute(context, family.features[i]) && ok;
+            }
+        });
+        if (!ok || writeStore(family.storeFile, computer, names, family.features) != 0) {
+            std::cerr << "Warning: No " << computer.featureType << " store for the later stages" << std::endl;
+            continue;
+        }
+        families.push_back(std::move(family));
+    }
+
+    // The later stages use a histogram family, matched with L1 like textureColor2
+    auto primary = std::find_if(families.begin(), families.end(), [](const FamilyData& f) { return f.computer->featureType == "hsv-sobel"; });
+    if (primary == families.end()) {
+        primary = families.begin();
+    }
+    if (primary == families.end()) {
+        std::cerr << "Error: No feature family could be computed" << std::endl;
+        return 1;
+    }
+    const FeatureComputer& computer = *primary->computer;
+    std::string storeFile = primary->storeFile;
+    std::string csvFile = (fs::path(directory) / (computer.featureType + ".csv")).string();
+    std::string importedFile = (fs::path(directory) / "imported.bin").string();
+    recorder.setConfig("primaryFeature", jsonString(computer.featureType));
+
+    // CSV and binary stores
+    recorder.time("store.writeCsv", count, [&] { writeCsv(csvFile, names, primary->features); });
+    recorder.time("store.writeBinary", count, [&] { writeStore(storeFile, computer, names, primary->features); });
+    recorder.time("store.importCsv", count, [&] { importCsvFeatures(csvFile, importedFile, computer.featureType, computer.normalization); });
+    recorder.time("store.openBinary", count, [&] {
+        FeatureStore store;
+        if (store.open(storeFile) == 0) {
+            for (size_t i = 0; i < store.size(); ++i) {
+                benchmarkSink = benchmarkSink + store.row(i)[0];
+            }
+        }
+    });
+
+    FeatureStore store;
+    if (store.open(storeFile) != 0) {
+        return 1;
+    }
+    size_t dim = store.dim();
+    size_t pairs = queries.size() * count;
+    recorder.setConfig("primaryDim", std::to_string(dim));
+
+    // Distance kernels, every query against every row
+    auto timeDistance = [&](const std::string& name, float (*distance)(const float*, const float*, size_t)) {
+        recorder.time("distance." + name, pairs, [&] {
+            double sum = 0.0;
+            for (size_t q : queries) {
+                for (size_t i = 0; i < count; ++i) {
+                    sum += distance(store.row(q), store.row(i), dim);
+                }
+            }
+            benchmarkSink = benchmarkSink + sum;
+        });
+    };
+    timeDistance("ssd", ssdDistance);
+    timeDistance("l1", l1Distance);
+    timeDistance("intersection", histogramIntersection);
+    recorder.time("distance.cosine", pairs, [&] {
+        double sum = 0.0;
+        for (size_t q : queries) {
+            float norm = l2Norm(store.row(q), dim);
+            for (size_t i = 0; i < count; ++i) {
+                sum += cosineDistance(store.row(q), store.row(i), dim, norm);
+            }
+        }
+        benchmarkSink = benchmarkSink + sum;
+    });
+
+    FeatureStore quantized;
+    if (openQuantizedStore(quantized, store, storeFile, FS_DTYPE_UINT8) == 0) {
+        recorder.time("distance.l1.uint8", pairs, [&] {
+            double sum = 0.0;
+            for (size_t q : queries) {
+                for (size_t i = 0; i < count; ++i) {
+                    sum += uint8Distance(QUANT_L1, quantized.codes(q), quantized.rowScale(q), quantized.codes(i), quantized.rowScale(i), dim);
+                }
+            }
+            benchmarkSink = benchmarkSink + sum;
+        });
+    } else {
+        recorder.skip("distance.l1.uint8", "features are negative");
+    }
+    if (openQuantizedStore(quantized, store, storeFile, FS_DTYPE_FLOAT16) == 0) {
+        recorder.time("distance.l1.fp16", pairs, [&] {
+            double sum = 0.0;
+            for (size_t q : queries) {
+                for (size_t i = 0; i < count; ++i) {
+                    sum += float16Distance(QUANT_L1, store.row(q), quantized.halfRow(i), dim);
+                }
+            }
+            benchmarkSink = benchmarkSink + sum;
+        });
+    }
+
+    // Top-k selection alone, over precomputed distances
+    std::vector<float> distances(pairs);
+    for (size_t q = 0; q < queries.size(); ++q) {
+        for (size_t i = 0; i < count; ++i) {
+            distances[q * count + i] = l1Distance(store.row(queries[q]), store.row(i), dim);
+        }
+    }
+    recorder.time("topk", pairs, [&] {
+        for (size_t q = 0; q < queries.size(); ++q) {
+            TopK best(k);
+            for (size_t i = 0; i < count; ++i) {
+                best.push(static_cast<uint32_t>(i), distances[q * count + i]);
+            }
+            benchmarkSink = benchmarkSink + best.sorted().size();
+        }
+    });
+
+    // The matcher scans; the first call of each mode writes its store copy outside the timing
+    for (const char* modeName : {"exact", "pruned", "variance", "uint8", "fp16"}) {
+        ScanMode mode;
+        parseScanMode(modeName, mode);
+        TopK warmup(k);
+        if (prunedScan(store, storeFile, store.row(0), PRUNED_L1, 0, mode, warmup) != 0) {
+            recorder.skip(std::string("match.") + modeName, "scan mode unavailable for this store");
+            continue;
+        }
+        recorder.time(std::string("match.") + modeName, queries.size(), [&] {
+            for (size_t q : queries) {
+                TopK best(k);
+                prunedScan(store, storeFile, store.row(q), PRUNED_L1, static_cast<long>(q), mode, best);
+                benchmarkSink = benchmarkSink + best.threshold();
+            }
+        });
+    }
+
+    // Pixel k-means of extensionFace (K = 7 colours) on up to ten images
+    size_t kmeansImages = std::min<size_t>(count, 10);
+    recorder.time("kmeans.pixels", kmeansImages, [&] {
+        KmeansOptions kmeansOptions;
+        kmeansOptions.threads = 1;
+        std::vector<float> means;
+        std::vector<int> labels;
+        for (size_t i = 0; i < kmeansImages; ++i) {
+            cv::Mat image = color[i].isContinuous() ? color[i] : color[i].clone();
+            labels.resize(image.total());
+            kmeansCluster(image.ptr<uint8_t>(), image.total(), 3, 7, means, labels.data(), kmeansOptions);
+            benchmarkSink = benchmarkSink + means[0];
+        }
+    });
+
+    // Face detection, one image at a time and as a parallel batch
+    FaceDetector detector;
+    if (detector.load(cascadeFile) == 0) {
+        size_t facesFound = 0;
+        recorder.time("faces.detect", count, [&] {
+            std::vector<cv::Rect> faces;
+            facesFound = 0;
+            for (size_t i = 0; i < count; ++i) {
+                detector.detect(color[i], faces);
+                facesFound += faces.size();
+            }
+        });
+        recorder.time("faces.detectBatch", count, [&] {
+            std::vector<FaceResult> results;
+            detector.detectBatch(color, results);
+            benchmarkSink = benchmarkSink + results.size();
+        });
+        recorder.setConfig("facesFound", std::to_string(facesFound));
+    } else {
+        recorder.skip("faces.detect", "cascade file " + cascadeFile + " not found");
+    }
+
+    // End to end: read, decode, extract and store the collection; answer a query from disk
+    std::string ingestFile = (fs::path(directory) / "ingest.bin").string();
+    recorder.time("endToEnd.ingest", count, [&] {
+        FeatureStoreWriter writer;
+        writer.open(ingestFile, computer.featureType, computer.normalization);
+        auto compute = [&](const fs::path& path, std::vector<float>& features) {
+            cv::Mat image = cv::imread(path.string(), computer.needsColor ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE);
+            if (image.empty()) {
+                return false;
+            }
+            ImageContext context(image);
+            return computer.compute(context, features);
+        };
+        runIngestPipeline(imageDir, compute, [&](const std::string& filename, const std::vector<float>& features) {
+            writer.append(filename, features);
+        });
+        writer.close();
+    });
+    recorder.time("endToEnd.query", queries.size(), [&] {
+        for (size_t q : queries) {
+            FeatureStore queryStore;
+            if (queryStore.open(storeFile) != 0) {
+                continue;
+            }
+            long target = queryStore.find(names[q]);
+            TopK best(k);
+            prunedScan(queryStore, storeFile, queryStore.row(target), PRUNED_L1, target, SCAN_PRUNED, best);
+            for (const auto& match : best.sorted()) {
+                benchmarkSink = benchmarkSink + queryStore.name(match.id).size();
+            }
+        }
+    });
+
+    if (recorder.writeJson(outputFile) != 0) {
+        return 1;
+    }
+    std::cout << "Wrote " << outputFile << std::endl;
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+
+chromaticity.cpp
+Project 2
+
+Chromaticity histogram computation and ingest into a feature store.
+
+**/
+
+#include "chromaticity.h"
+#include "featureStore.h"
+#include "ingestPipeline.h"
+#include "ingestManifest.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// floor(c * bins / s) == (c * reciprocal[s]) >> RECIPROCAL_SHIFT for every channel value c <= 255 and
+// sum s <= 765, since 255 * 765 < 2^18; c * reciprocal[s] <= 255 * 64 * 2^18 fits in 32 bits
+static const int RECIPROCAL_SHIFT = 18;
+static const int MAX_CHANNEL_SUM = 3 * 255;
+
+std::string chromaticityFeatureType(int bins) {
+    return bins == CHROMATICITY_BINS ? "chromaticity-rg" : "chromaticity-rg:" + std::to_string(bins);
+}
+
+bool isChromaticityFeatureType(const std::string& featureType, uint32_t dim) {
+    int bins = static_cast<int>(std::lround(std::sqrt(static_cast<double>(dim))));
+    return bins >= 1 && bins <= CHROMATICITY_MAX_BINS && static_cast<uint32_t>(bins * bins) == dim &&
+           featureType == chromaticityFeatureType(bins);
+}
+
+// Accumulate the r-major bin of n BGR pixels; black pixels land in bin (0, 0) and are also counted in black
+static void chromaticityBinsScalar(const uchar* bgr, int n, const uint32_t* reciprocal, int bins, uint32_t* counts, uint32_t& black) {
+    uint32_t maxBin = bins - 1;
+    for (int x = 0; x < n; ++x, bgr += 3) {
+        uint32_t sum = bgr[0] + bgr[1] + bgr[2];
+        uint32_t m = reciprocal[sum];
+        uint32_t r = std::min((bgr[2] * m) >> RECIPROCAL_SHIFT, maxBin);
+        uint32_t g = std::min((bgr[1] * m) >> RECIPROCAL_SHIFT, maxBin);
+        ++counts[r * bins + g];
+        black += sum == 0;
+    }
+}
+
+#ifdef CBIR_X86_SIMD
+CBIR_TARGET_AVX2 static void chromaticityBinsAvx2(const uchar* bgr, int n, const uint32_t* reciprocal, int bins, uint32_t* counts, uint32_t& black) {
+    // Spread 8 packed BGR pixels to one pixel per 32-bit lane: each 128-bit half gets the
+    // 16 bytes holding its 4 pixels, then a byte shuffle moves pixel k to lane k
+    const __m256i halves = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256i maxBin = _mm256_set1_epi32(bins - 1);
+    const __m256i binsPerRow = _mm256_set1_epi32(bins);
+    alignas(32) uint32_t index[8];
+
+    int x = 0;
+    // The 32-byte load reads 8 bytes past the 8 pixels, so stop while they are still in the row
+    for (; 3 * x + 32 <= 3 * n; x += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgr + 3 * x));
+        pixels = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(pixels, halves), spread);
+        __m256i b = _mm256_and_si256(pixels, byteMask);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask);
+        __m256i r = _mm256_srli_epi32(pixels, 16);
+
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(b, g), r);
+        __m256i m = _mm256_i32gather_epi32(reinterpret_cast<const int*>(reciprocal), sum, 4);
+        __m256i rBin = _mm256_min_epu32(_mm256_srli_epi32(_mm256_mullo_epi32(r, m), RECIPROCAL_SHIFT), maxBin);
+        __m256i gBin = _mm256_min_epu32(_mm256_srli_epi32(_mm256_mullo_epi32(g, m), RECIPROCAL_SHIFT), maxBin);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(index), _mm256_add_epi32(_mm256_mullo_epi32(rBin, binsPerRow), gBin));
+
+        int blackMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(sum, _mm256_setzero_si256())));
+        black += __builtin_popcount(blackMask);
+        for (int k = 0; k < 8; ++k) {
+            ++counts[index[k]];
+        }
+    }
+    chromaticityBinsScalar(bgr + 3 * x, n - x, reciprocal, bins, counts, black);
+}
+#endif
+
+typedef void (*ChromaticityBinsRow)(const uchar*, int, const uint32_t*, int, uint32_t*, uint32_t&);
+
+static ChromaticityBinsRow chromaticityBinsRow() {
+    static const ChromaticityBinsRow row = [] {
+#ifdef CBIR_X86_SIMD
+        if (detectSimdLevel() >= SIMD_AVX2) {
+            return chromaticityBinsAvx2;
+        }
+#endif
+        return chromaticityBinsScalar;
+    }();
+    return row;
+}
+
+void computeChromaticityHistogram(const cv::Mat& image, std::vector<float>& histogram, int bins) {
+    histogram.clear();
+    if (image.empty() || image.type() != CV_8UC3 || bins < 1 || bins > CHROMATICITY_MAX_BINS) {
+        return;
+    }
+
+    uint32_t reciprocal[MAX_CHANNEL_SUM + 1];
+    reciprocal[0] = 0;
+    for (uint32_t s = 1; s <= MAX_CHANNEL_SUM; ++s) {
+        reciprocal[s] = ((static_cast<uint32_t>(bins) << RECIPROCAL_SHIFT) + s - 1) / s;
+    }
+
+    std::vector<uint32_t> counts(static_cast<size_t>(bins) * bins, 0);
+    uint32_t black = 0;
+    ChromaticityBinsRow binRow = chromaticityBinsRow();
+    for (int y = 0; y < image.rows; ++y) {
+        binRow(image.ptr<uchar>(y), image.cols, reciprocal, bins, counts.data(), black);
+    }
+
+    // Black has no chromaticity; count it with the greys at r = g = 1/3
+    int neutral = bins / 3;
+    counts[0] -= black;
+    counts[neutral * bins + neutral] += black;
+
+    float total = static_cast<float>(image.total());
+    histogram.resize(counts.size());
+    for (size_t i = 0; i < counts.size(); ++i) {
+        histogram[i] = counts[i] / total;
+    }
+}
+
+float computeHistogramIntersection(const float* hist1, const float* hist2, size_t bins) {
+    // Same value as cv::compareHist(..., cv::HISTCMP_INTERSECT)
+    return histogramIntersection(hist1, hist2, bins);
+}
+
+int extractChromaticityFeaturesAndSave(const std::string& inputDir, const std::string& storeFile, bool incremental, int bins) {
+    if (bins < 1 || bins > CHROMATICITY_MAX_BINS) {
+        std::cerr << "Error: Chromaticity bins must be between 1 and " << CHROMATICITY_MAX_BINS << ".\n";
+        return -1;
+    }
+
+    auto compute = [bins](const fs::path& path, std::vector<float>& features) {
+        cv::Mat image = cv::imread(path.string());
+        if (image.empty()) {
+            std::cerr << "Error: Unable to read the image at path " << path << ".\n";
+            return false;
+        }
+
+        computeChromaticityHistogram(image, features, bins);
+        return !features.empty();
+    };
+
+    long written = runStoreIngest(inputDir, storeFile, chromaticityFeatureType(bins), FS_NORM_L1, compute, FeatureSink(), incremental);
+    return written < 0 ? -1 : 0;
+}
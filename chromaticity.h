@@ -0,0 +1,45 @@
+/**
+
+chromaticity.h
+Project 2
+
+Chromaticity histogram feature used by Task 2 and Task 7: a 2D histogram of the
+r = R/(R+G+B) and g = G/(R+G+B) chromaticities, normalized to sum to one. Pixels
+are binned in a single pass with integer arithmetic; a reciprocal table replaces
+the division by R+G+B. Black pixels count as neutral grey. The histograms are
+computed once at ingest and kept in a feature store, so a query on an image of the
+collection reads its stored histogram instead of decoding it.
+
+**/
+#ifndef CHROMATICITY_H
+#define CHROMATICITY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Bins per chromaticity axis; the feature has CHROMATICITY_BINS^2 values
+#define CHROMATICITY_BINS 16
+#define CHROMATICITY_MAX_BINS 64
+
+// Feature type of a bins x bins histogram: "chromaticity-rg", or "chromaticity-rg:<bins>" for
+// a bin count other than the default
+std::string chromaticityFeatureType(int bins = CHROMATICITY_BINS);
+
+// True if a store of this feature type and dim holds chromaticity histograms of any bin count
+bool isChromaticityFeatureType(const std::string& featureType, uint32_t dim);
+
+// Compute the bins x bins rg chromaticity histogram of a BGR (CV_8UC3) image, r-major.
+// Leaves histogram empty if the image is not BGR or bins is outside 1..CHROMATICITY_MAX_BINS.
+void computeChromaticityHistogram(const cv::Mat& image, std::vector<float>& histogram, int bins = CHROMATICITY_BINS);
+
+// Histogram intersection of two flattened histograms
+float computeHistogramIntersection(const float* hist1, const float* hist2, size_t bins);
+
+// Compute the chromaticity histogram of every image in inputDir and write them to a feature store;
+// incremental reuses the stored histograms of images that have not changed since the last run
+int extractChromaticityFeaturesAndSave(const std::string& inputDir, const std::string& storeFile, bool incremental = false,
+                                       int bins = CHROMATICITY_BINS);
+
+#endif
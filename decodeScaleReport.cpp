@@ -0,0 +1,147 @@
+/**
+
+decodeScaleReport.cpp
+Project 2
+
+Accuracy report for reduced-resolution decoding. Extracts one feature family from
+the image directory at full resolution and at 1/2, 1/4 and 1/8 scale, then ranks the
+collection for a set of query images at every scale and compares each ranking with
+the full-resolution one. Use it to pick the fastest --scale that keeps the top-k
+stable before rebuilding a store with it.
+
+Usage: decodeScaleReport <featureType> [k] [numQueries] [imageDir]
+
+**/
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "featureCatalog.h"
+#include "featureRegistry.h"
+#include "ingestPipeline.h"
+#include "topK.h"
+
+namespace fs = std::filesystem;
+
+// Features of one extraction pass, in directory order
+struct ScaledFeatures {
+    FeatureCatalog features;
+    double msPerImage = 0.0;
+};
+
+static int extractAtScale(const std::string& inputDir, const FeatureComputer& computer, int scale, ScaledFeatures& result) {
+    int flag = reducedImreadFlag(computer.needsColor, scale);
+    auto compute = [&](const fs::path& path, std::vector<float>& features) {
+        cv::Mat image = cv::imread(path.string(), flag);
+        if (image.empty()) {
+            std::cerr << "Error: Unable to read image at path " << path << std::endl;
+            return false;
+        }
+        ImageContext context(image);
+        return computer.compute(context, features);
+    };
+    auto collect = [&](const std::string& filename, const std::vector<float>& features) {
+        result.features.add(filename, features);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    long written = runIngestPipeline(inputDir, compute, collect);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (written <= 0) {
+        return -1;
+    }
+    result.msPerImage = ms / written;
+    result.features.buildBlocks();
+    return 0;
+}
+
+// Ids of the k best matches of row query under the family's default metric
+static std::vector<uint32_t> rankMatches(const ScaledFeatures& scaled, size_t query, const std::string& metric, int k) {
+    CatalogMetric catalogMetric = metric == "ssd" ? CATALOG_SSD : metric == "intersection" ? CATALOG_INTERSECTION : CATALOG_L1;
+    TopK best(k, catalogMetric == CATALOG_INTERSECTION);
+    scaled.features.scan(scaled.features.row(query), catalogMetric, static_cast<long>(query), best);
+
+    std::vector<uint32_t> ids;
+    for (const auto& match : best.sorted()) {
+        ids.push_back(match.id);
+    }
+    return ids;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <featureType> [k] [numQueries] [imageDir]" << std::endl;
+        return 1;
+    }
+    std::string featureType = argv[1];
+    int k = argc > 2 ? std::atoi(argv[2]) : 5;
+    int numQueries = argc > 3 ? std::atoi(argv[3]) : 100;
+    std::string inputDirectory = argc > 4 ? argv[4] : "../olympus";
+
+    const FeatureComputer* computer = findFeatureComputer(featureType);
+    if (!computer || !computer->scalable) {
+        std::cerr << "Error: " << featureType << " is not a feature that supports reduced decoding" << std::endl;
+        return 1;
+    }
+
+    ScaledFeatures reference;
+    if (extractAtScale(inputDirectory, *computer, 1, reference) != 0) {
+        return 1;
+    }
+    size_t count = reference.features.size();
+    numQueries = std::max(1, std::min(numQueries, static_cast<int>(count)));
+    k = std::max(1, std::min(k, static_cast<int>(count) - 1));
+
+    std::vector<size_t> queries;
+    std::vector<std::vector<uint32_t>> referenceRankings;
+    for (int q = 0; q < numQueries; ++q) {
+        queries.push_back(static_cast<size_t>(q) * count / numQueries);
+        referenceRankings.push_back(rankMatches(reference, queries.back(), computer->defaultMetric, k));
+    }
+
+    std::cout << featureType << ", " << count << " images, " << numQueries << " queries, metric " << computer->defaultMetric << "\n";
+    std::cout << "scale  ms/image  speedup  overlap@" << k << "  top-1 agreement\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "1      " << std::setw(8) << reference.msPerImage << "  1.000    1.000      1.000\n";
+
+    for (int scale : {2, 4, 8}) {
+        ScaledFeatures scaled;
+        if (extractAtScale(inputDirectory, *computer, scale, scaled) != 0) {
+            return 1;
+        }
+
+        // Rows are matched by filename in case an image failed at one scale only
+        size_t found = 0, expected = 0, topAgree = 0, compared = 0;
+        for (size_t q = 0; q < queries.size(); ++q) {
+            long query = scaled.features.find(reference.features.name(queries[q]));
+            if (query < 0 || referenceRankings[q].empty()) {
+                continue;
+            }
+            std::vector<uint32_t> ranking = rankMatches(scaled, static_cast<size_t>(query), computer->defaultMetric, k);
+            for (uint32_t id : referenceRankings[q]) {
+                ++expected;
+                for (uint32_t candidate : ranking) {
+                    if (scaled.features.name(candidate) == reference.features.name(id)) {
+                        ++found;
+                        break;
+                    }
+                }
+            }
+            ++compared;
+            if (!ranking.empty() && scaled.features.name(ranking[0]) == reference.features.name(referenceRankings[q][0])) {
+                ++topAgree;
+            }
+        }
+
+        std::cout << scale << "      " << std::setw(8) << scaled.msPerImage << "  " << std::setw(5)
+                  << reference.msPerImage / scaled.msPerImage << "    " << (expected ? static_cast<double>(found) / expected : 0.0)
+                  << "      " << (compared ? static_cast<double>(topAgree) / compared : 0.0) << "\n";
+    }
+    return 0;
+}
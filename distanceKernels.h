@@ -0,0 +1,494 @@
+/**
+
+distanceKernels.h
+Project 2
+
+Distance kernels shared by every matcher: sum-of-squared-difference, L1, histogram
+intersection, dot product and cosine distance over float vectors. Each kernel has an
+AVX-512, an AVX2 and a scalar implementation; the fastest one the CPU supports is
+picked once at startup. Set CBIR_SIMD=scalar, avx2 or avx512 to force a path.
+
+The bounded SSD and L1 kernels check the running sum every DISTANCE_BOUND_BLOCK
+dimensions and give up once it exceeds a bound (the current k-th best distance of a
+scan). They accumulate in exactly the same order as the plain kernels, so a distance
+that is not abandoned is bit-identical to the unbounded one.
+
+**/
+#ifndef DISTANCEKERNELS_H
+#define DISTANCEKERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CBIR_X86_SIMD 1
+#include <immintrin.h>
+#define CBIR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define CBIR_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_AVX2 = 1,
+    SIMD_AVX512 = 2
+};
+
+typedef float (*DistanceKernel)(const float* a, const float* b, size_t n);
+
+// Returns the distance if it is at most bound, otherwise a partial sum greater than bound.
+// scanned (may be null) receives the number of dimensions that were read.
+typedef float (*BoundedDistanceKernel)(const float* a, const float* b, size_t n, float bound, size_t* scanned);
+
+// Dimensions between checks of the bounded kernels; a multiple of every SIMD step
+#define DISTANCE_BOUND_BLOCK 64
+
+// Dot product of a and b that also returns the squared norm of b, in one pass
+typedef float (*DotNormKernel)(const float* a, const float* b, size_t n, float* normB2);
+
+struct DistanceKernelTable {
+    SimdLevel level;
+    DistanceKernel ssd;
+    DistanceKernel l1;
+    DistanceKernel intersection;
+    DistanceKernel dot;
+    DotNormKernel dotNorm;
+    BoundedDistanceKernel ssdBounded;
+    BoundedDistanceKernel l1Bounded;
+};
+
+namespace kernels_scalar {
+
+inline float ssd(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+inline float l1(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += std::fabs(a[i] - b[i]);
+    }
+    return sum;
+}
+
+inline float intersection(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += a[i] < b[i] ? a[i] : b[i];
+    }
+    return sum;
+}
+
+inline float dot(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+inline float dotNorm(const float* a, const float* b, size_t n, float* normB2) {
+    float sum = 0.0f, norm = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+        norm += b[i] * b[i];
+    }
+    *normB2 = norm;
+    return sum;
+}
+
+inline float ssdBounded(const float* a, const float* b, size_t n, float bound, size_t* scanned) {
+    float sum = 0.0f;
+    size_t i = 0;
+    while (i < n) {
+        size_t end = n - i > DISTANCE_BOUND_BLOCK ? i + DISTANCE_BOUND_BLOCK : n;
+        for (; i < end; ++i) {
+            float d = a[i] - b[i];
+            sum += d * d;
+        }
+        if (sum > bound) {
+            break;
+        }
+    }
+    if (scanned) {
+        *scanned = i;
+    }
+    return sum;
+}
+
+inline float l1Bounded(const float* a, const float* b, size_t n, float bound, size_t* scanned) {
+    float sum = 0.0f;
+    size_t i = 0;
+    while (i < n) {
+        size_t end = n - i > DISTANCE_BOUND_BLOCK ? i + DISTANCE_BOUND_BLOCK : n;
+        for (; i < end; ++i) {
+            sum += std::fabs(a[i] - b[i]);
+        }
+        if (sum > bound) {
+            break;
+        }
+    }
+    if (scanned) {
+        *scanned = i;
+    }
+    return sum;
+}
+
+} // namespace kernels_scalar
+
+#ifdef CBIR_X86_SIMD
+
+namespace kernels_avx2 {
+
+CBIR_TARGET_AVX2 inline float hsum(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+    return _mm_cvtss_f32(lo);
+}
+
+// Two 8-lane accumulators hide the FMA latency; the tail is finished in scalar code
+CBIR_TARGET_AVX2 inline float ssd(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    float sum = hsum(_mm256_add_ps(acc0, acc1));
+    return sum + kernels_scalar::ssd(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float l1(const float* a, const float* b, size_t n) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(signMask, d0));
+        acc1 = _mm256_add_ps(acc1, _mm256_andnot_ps(signMask, d1));
+    }
+    float sum = hsum(_mm256_add_ps(acc0, acc1));
+    return sum + kernels_scalar::l1(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float intersection(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_min_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_min_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    float sum = hsum(_mm256_add_ps(acc0, acc1));
+    return sum + kernels_scalar::intersection(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float dot(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    float sum = hsum(_mm256_add_ps(acc0, acc1));
+    return sum + kernels_scalar::dot(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float dotNorm(const float* a, const float* b, size_t n, float* normB2) {
+    __m256 accDot = _mm256_setzero_ps(), accNorm = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vb = _mm256_loadu_ps(b + i);
+        accDot = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), vb, accDot);
+        accNorm = _mm256_fmadd_ps(vb, vb, accNorm);
+    }
+    float tailNorm;
+    float sum = hsum(accDot) + kernels_scalar::dotNorm(a + i, b + i, n - i, &tailNorm);
+    *normB2 = hsum(accNorm) + tailNorm;
+    return sum;
+}
+
+// Same loops as ssd and l1; the lanes only grow, so a partial horizontal sum above bound
+// means the full distance is above it too
+CBIR_TARGET_AVX2 inline float ssdBounded(const float* a, const float* b, size_t n, float bound, size_t* scanned) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        if ((i + 16) % DISTANCE_BOUND_BLOCK == 0 && i + 16 < n) {
+            float partial = hsum(_mm256_add_ps(acc0, acc1));
+            if (partial > bound) {
+                if (scanned) {
+                    *scanned = i + 16;
+                }
+                return partial;
+            }
+        }
+    }
+    if (scanned) {
+        *scanned = n;
+    }
+    float sum = hsum(_mm256_add_ps(acc0, acc1));
+    return sum + kernels_scalar::ssd(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float l1Bounded(const float* a, const float* b, size_t n, float bound, size_t* scanned) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(signMask, d0));
+        acc1 = _mm256_add_ps(acc1, _mm256_andnot_ps(signMask, d1));
+        if ((i + 16) % DISTANCE_BOUND_BLOCK == 0 && i + 16 < n) {
+            float partial = hsum(_mm256_add_ps(acc0, acc1));
+            if (partial > bound) {
+                if (scanned) {
+                    *scanned = i + 16;
+                }
+                return partial;
+            }
+        }
+    }
+    if (scanned) {
+        *scanned = n;
+    }
+    float sum = hsum(_mm256_add_ps(acc0, acc1));
+    return sum + kernels_scalar::l1(a + i, b + i, n - i);
+}
+
+} // namespace kernels_avx2
+
+// GCC 12 reports false uninitialized warnings inside the AVX-512 intrinsic headers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace kernels_avx512 {
+
+CBIR_TARGET_AVX512 inline float ssd(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    return sum + kernels_scalar::ssd(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX512 inline float l1(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(d0));
+        acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(d1));
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    return sum + kernels_scalar::l1(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX512 inline float intersection(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_ps(acc0, _mm512_min_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+        acc1 = _mm512_add_ps(acc1, _mm512_min_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16)));
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    return sum + kernels_scalar::intersection(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX512 inline float dot(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    return sum + kernels_scalar::dot(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX512 inline float dotNorm(const float* a, const float* b, size_t n, float* normB2) {
+    __m512 accDot = _mm512_setzero_ps(), accNorm = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 vb = _mm512_loadu_ps(b + i);
+        accDot = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), vb, accDot);
+        accNorm = _mm512_fmadd_ps(vb, vb, accNorm);
+    }
+    float tailNorm;
+    float sum = _mm512_reduce_add_ps(accDot) + kernels_scalar::dotNorm(a + i, b + i, n - i, &tailNorm);
+    *normB2 = _mm512_reduce_add_ps(accNorm) + tailNorm;
+    return sum;
+}
+
+CBIR_TARGET_AVX512 inline float ssdBounded(const float* a, const float* b, size_t n, float bound, size_t* scanned) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        if ((i + 32) % DISTANCE_BOUND_BLOCK == 0 && i + 32 < n) {
+            float partial = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+            if (partial > bound) {
+                if (scanned) {
+                    *scanned = i + 32;
+                }
+                return partial;
+            }
+        }
+    }
+    if (scanned) {
+        *scanned = n;
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    return sum + kernels_scalar::ssd(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX512 inline float l1Bounded(const float* a, const float* b, size_t n, float bound, size_t* scanned) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(d0));
+        acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(d1));
+        if ((i + 32) % DISTANCE_BOUND_BLOCK == 0 && i + 32 < n) {
+            float partial = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+            if (partial > bound) {
+                if (scanned) {
+                    *scanned = i + 32;
+                }
+                return partial;
+            }
+        }
+    }
+    if (scanned) {
+        *scanned = n;
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    return sum + kernels_scalar::l1(a + i, b + i, n - i);
+}
+
+} // namespace kernels_avx512
+
+#pragma GCC diagnostic pop
+
+#endif // CBIR_X86_SIMD
+
+// Highest SIMD level supported by this CPU, capped by the CBIR_SIMD environment variable
+inline SimdLevel detectSimdLevel() {
+    SimdLevel level = SIMD_SCALAR;
+#ifdef CBIR_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        level = SIMD_AVX512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        level = SIMD_AVX2;
+    }
+#endif
+    const char* forced = std::getenv("CBIR_SIMD");
+    if (forced) {
+        if (std::strcmp(forced, "scalar") == 0) {
+            level = SIMD_SCALAR;
+        } else if (std::strcmp(forced, "avx2") == 0 && level > SIMD_AVX2) {
+            level = SIMD_AVX2;
+        }
+    }
+    return level;
+}
+
+// Kernel table for the current CPU, resolved on first use
+inline const DistanceKernelTable& distanceKernels() {
+    static const DistanceKernelTable table = [] {
+        SimdLevel level = detectSimdLevel();
+#ifdef CBIR_X86_SIMD
+        if (level == SIMD_AVX512) {
+            return DistanceKernelTable{level, kernels_avx512::ssd, kernels_avx512::l1, kernels_avx512::intersection,
+                                       kernels_avx512::dot, kernels_avx512::dotNorm, kernels_avx512::ssdBounded,
+                                       kernels_avx512::l1Bounded};
+        }
+        if (level == SIMD_AVX2) {
+            return DistanceKernelTable{level, kernels_avx2::ssd, kernels_avx2::l1, kernels_avx2::intersection,
+                                       kernels_avx2::dot, kernels_avx2::dotNorm, kernels_avx2::ssdBounded,
+                                       kernels_avx2::l1Bounded};
+        }
+#endif
+        return DistanceKernelTable{SIMD_SCALAR, kernels_scalar::ssd, kernels_scalar::l1, kernels_scalar::intersection,
+                                   kernels_scalar::dot, kernels_scalar::dotNorm, kernels_scalar::ssdBounded,
+                                   kernels_scalar::l1Bounded};
+    }();
+    return table;
+}
+
+inline const char* simdLevelName(SimdLevel level) {
+    return level == SIMD_AVX512 ? "avx512" : level == SIMD_AVX2 ? "avx2" : "scalar";
+}
+
+// Sum of squared differences
+inline float ssdDistance(const float* a, const float* b, size_t n) {
+    return distanceKernels().ssd(a, b, n);
+}
+
+// Sum of absolute differences
+inline float l1Distance(const float* a, const float* b, size_t n) {
+    return distanceKernels().l1(a, b, n);
+}
+
+// SSD and L1 that stop once the sum exceeds bound; see BoundedDistanceKernel
+inline float ssdDistanceBounded(const float* a, const float* b, size_t n, float bound, size_t* scanned = nullptr) {
+    return distanceKernels().ssdBounded(a, b, n, bound, scanned);
+}
+
+inline float l1DistanceBounded(const float* a, const float* b, size_t n, float bound, size_t* scanned = nullptr) {
+    return distanceKernels().l1Bounded(a, b, n, bound, scanned);
+}
+
+// Histogram intersection (sum of bin-wise minima), larger means more similar
+inline float histogramIntersection(const float* a, const float* b, size_t n) {
+    return distanceKernels().intersection(a, b, n);
+}
+
+inline float dotProduct(const float* a, const float* b, size_t n) {
+    return distanceKernels().dot(a, b, n);
+}
+
+inline float l2Norm(const float* a, size_t n) {
+    return std::sqrt(distanceKernels().dot(a, a, n));
+}
+
+// Angle between a and b in radians; normA is the precomputed L2 norm of a.
+// Returns -1 if either vector has zero length.
+inline float cosineDistance(const float* a, const float* b, size_t n, float normA) {
+    float normB2;
+    float dot = distanceKernels().dotNorm(a, b, n, &normB2);
+    if (normA == 0.0f || normB2 == 0.0f) {
+        return -1.0f;
+    }
+    float cosine = dot / (normA * std::sqrt(normB2));
+    cosine = cosine > 1.0f ? 1.0f : (cosine < -1.0f ? -1.0f : cosine);
+    return std::acos(cosine);
+}
+
+#endif
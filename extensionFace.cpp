@@ -16,106 +16,125 @@ performs cartoonization on the detected faces using Kmeans
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <filesystem>
-#include "faceDetect.cpp"
-#include "kmeans.h"
-#include "kmeans.cpp"
+#include <string>
+#include <vector>
+#include "faceDetect.h"
+#include "faceDetector.h"
+#include "faceIndex.h"
+#include "ingestPipeline.h"
+#include "kmeansEngine.h"
 
 namespace fs = std::filesystem;
 
-// Function to detect faces in a single image
-void detectFacesInImage(cv::Mat &image, std::vector<cv::Rect>& faces) {
-    cv::Mat gray;
-    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+// Number of colors in the cartoonized image
+static const int K = 7;
 
-    // Detect faces
-    detectFaces(gray, faces);
-    drawBoxes(image, faces );
-}
-
-// Function to perform K-means clustering on a list of images
-void performKMeansClustering(const std::vector<cv::Mat>& images, const std::string& outputDirectory) {
-    // Set K (number of clusters)
-    int K = 7;
-
-    // Iterate through the images and perform K-means clustering
-    for (size_t i = 0; i < images.size(); ++i) {
-        const cv::Mat& image = images[i];
-
-        // Flatten the image to a vector of cv::Vec3b
-        std::vector<cv::Vec3b> data;
-        for (int y = 0; y < image.rows; ++y) {
-            for (int x = 0; x < image.cols; ++x) {
-                data.push_back(image.at<cv::Vec3b>(y, x));
-            }
-        }
-
-        // Allocate space for labels
-        int* labels = new int[data.size()];
-
-        // Vector to store cluster means
-        std::vector<cv::Vec3b> means;
-
-        // Run the K-means algorithm
-        int maxIterations = 10;  // You can adjust this value
-        int stopThresh = 0;      // You can adjust this value
-        int result = kmeans(data, means, labels, K, maxIterations, stopThresh);
-
-        if (result == 0) {
-            // Save the clustered image
-            fs::path outputPath = fs::path(outputDirectory) / ("clustered_" + std::to_string(i) + ".jpg");
-            cv::Mat clusteredImg(image.size(), image.type());
-            for (int y = 0; y < image.rows; ++y) {
-                for (int x = 0; x < image.cols; ++x) {
-                    clusteredImg.at<cv::Vec3b>(y, x) = means[labels[y * image.cols + x]];
-                }
-            }
-
-            cv::imwrite(outputPath.string(), clusteredImg);
+// Function to perform K-means clustering on one image, replacing every pixel with its cluster mean.
+// The pixels are clustered in place; labels is the calling thread's buffer, reused across images.
+static bool performKMeansClustering(cv::Mat& image, std::vector<int>& labels) {
+    if (!image.isContinuous()) {
+        image = image.clone();
+    }
+    size_t numPixels = image.total();
+    labels.resize(numPixels);
+
+    // The workers already use every core, so each image is clustered on one thread
+    KmeansOptions options;
+    options.maxIterations = 10;
+    options.threads = 1;
+    std::vector<float> means;
+    if (kmeansCluster(image.ptr<uint8_t>(), numPixels, 3, K, means, labels.data(), options) != 0) {
+        return false;
+    }
 
-            std::cout << "K-means clustering completed for Image " << i << std::endl;
-        } else {
-            std::cerr << "Error: K-means algorithm failed for Image " << i << std::endl;
+    uchar palette[K][3];
+    for (int k = 0; k < K; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            palette[k][c] = cv::saturate_cast<uchar>(means[3 * k + c]);
         }
-
-        // Clean up
-        delete[] labels;
     }
+    uchar* pixel = image.ptr<uchar>();
+    for (size_t i = 0; i < numPixels; ++i, pixel += 3) {
+        const uchar* mean = palette[labels[i]];
+        pixel[0] = mean[0];
+        pixel[1] = mean[1];
+        pixel[2] = mean[2];
+    }
+    return true;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     // Specify the directory containing images
-    std::string directoryPath = "/home/rucha/CS5330/Project2/olympus/";
-    std::string outputDirectorypath = "/home/rucha/CS5330/Project2/";
+    std::string directoryPath = argc > 1 ? argv[1] : "/home/rucha/CS5330/Project2/olympus/";
+    std::string outputDirectorypath = argc > 2 ? argv[2] : "/home/rucha/CS5330/Project2/";
+    std::string faceIndexPath = argc > 3 ? argv[3] : FACE_INDEX_FILE;
+
+    // Load the cascade once up front; each worker borrows its own classifier from the detector
+    FaceDetector detector;
+    if (detector.load(FACE_CASCADE_FILE) != 0) {
+        return 1;
+    }
 
-    // Vector to store images with faces
-    std::vector<cv::Mat> imagesWithFaces;
+    // Faces found by earlier runs; only images that are new or changed are run through the cascade
+    FaceIndex faceIndex;
+    if (faceIndex.open(faceIndexPath, FACE_CASCADE_FILE) != 0) {
+        return 1;
+    }
 
-    // Iterate through the directory and process each image
-    for (const auto& entry : fs::directory_iterator(directoryPath)) {
-        std::string imagePath = entry.path().string();
+    // Each worker finds the faces of an image (from the index, or by decoding it and running
+    // the detector) and clusters it if there are any. Images without faces come back empty.
+    // At most maxInFlight images are decoded at any time.
+    auto cartoonize = [&](const fs::path& path, cv::Mat& clustered) {
+        thread_local std::vector<int> labels;
 
-        // Load the input image
-        cv::Mat image = cv::imread(imagePath);
+        // Detect faces in the image, or take them from the index without decoding it
+        std::vector<cv::Rect> faces;
+        cv::Mat image;
+        if (indexedDetectFaces(faceIndex, detector, path, faces, &image) != 0) {
+            return false;
+        }
+        if (faces.empty()) {
+            return true;
+        }
         if (image.empty()) {
-            std::cerr << "Error: Unable to load image: " << imagePath << std::endl;
-            continue; // Skip to the next image if loading fails
+            image = cv::imread(path.string());
+            if (image.empty()) {
+                std::cerr << "Error: Unable to load image: " << path.string() << std::endl;
+                return false;
+            }
         }
+        drawBoxes(image, faces );
 
-        // Detect faces in the image
-        std::vector<cv::Rect> faces;
-        detectFacesInImage(image, faces);
-
-        // Check if faces were detected
-        if (!faces.empty()) {
-            // Store images with faces
-            imagesWithFaces.push_back(image);
+        if (!performKMeansClustering(image, labels)) {
+            std::cerr << "Error: K-means algorithm failed for " << path.filename().string() << std::endl;
+            return false;
         }
+        clustered = image;
+        return true;
+    };
+
+    // Images with faces are numbered in directory order, as they were when all were clustered at the end
+    int imageIndex = 0;
+    auto save = [&](const std::string&, const cv::Mat& clustered) {
+        if (clustered.empty()) {
+            return;
+        }
+        fs::path outputPath = fs::path(outputDirectorypath) / ("clustered_" + std::to_string(imageIndex) + ".jpg");
+        cv::imwrite(outputPath.string(), clustered);
+        std::cout << "K-means clustering completed for Image " << imageIndex << std::endl;
+        ++imageIndex;
+    };
+
+    IngestOptions options;
+    options.maxInFlight = 2 * std::max(1u, std::thread::hardware_concurrency());
+    if (runOrderedPipeline<cv::Mat>(directoryPath, cartoonize, save, options) < 0) {
+        return 1;
     }
 
-    // Perform K-means clustering on the images with faces
-    if (!imagesWithFaces.empty()) {
-        performKMeansClustering(imagesWithFaces, outputDirectorypath);
-    } else {
+    std::cout << "Face index: " << faceIndex.hits() << " images known, " << faceIndex.misses() << " detected" << std::endl;
+    faceIndex.save();
+
+    if (imageIndex == 0) {
         std::cout << "No images with faces found in the directory." << std::endl;
     }
 
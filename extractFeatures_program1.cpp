@@ -4,92 +4,90 @@ Project 2
   
 Created by Ruohe Zhou and Rucha Pendharkar on 2/8/24
 
-This code is used for Task 1. The code extract features and form a features.csv file
+This code is used for Task 1. The code extract features and form a features.csv file, the
+matching features.bin store and the features_chroma.bin chromaticity histograms
 
 
 **/
 #include <cmath>
+#include <cstdlib>
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <vector>
+#include "featureStore.h"
+#include "chromaticity.h"
+#include "ingestPipeline.h"
+#include "ingestManifest.h"
+#include "imageFeatures.h"
 namespace fs = std::filesystem;
 
 
- void computeFeatures(cv::Mat& image, std::vector<float>& features) {
-    
-    cv::Ptr<cv::ORB> orb = cv::ORB::create();
-
-    // Compute the center region
-    int regionSize = 7;
-    int startX = image.cols / 2 - regionSize / 2;
-    int startY = image.rows / 2 - regionSize / 2;
-
-    // Clamp start coordinates to ensure region is within the image bounds
-    startX = std::max(0, startX);
-    startY = std::max(0, startY);
-    int endX = std::min(image.cols, startX + regionSize);
-    int endY = std::min(image.rows, startY + regionSize);
-
-    // Crop the center region
-    cv::Mat centerRegion = image(cv::Rect(startX, startY, endX - startX, endY - startY));
-
-    // Detect keypoints
-    std::vector<cv::KeyPoint> keypoints;
-    orb->detect(centerRegion, keypoints);
-
-    cv::Mat descriptors;
-    orb->compute(centerRegion, keypoints, descriptors);
+// Extract features from images in a directory and stream them to the CSV file and feature store
+void extractFeaturesAndSave(const std::string& inputDir, const std::string& outputFile, const std::string& storeFile = "", bool incremental = false) {
+    std::ofstream csvFile(outputFile);
 
-    // Convert descriptors to float vector
-    features.clear();
-    features.reserve(descriptors.rows * descriptors.cols);
-    for (int i = 0; i < descriptors.rows; ++i) {
-        for (int j = 0; j < descriptors.cols; ++j) {
-            features.push_back(static_cast<float>(descriptors.at<uchar>(i, j)));
+    auto compute = [](const fs::path& path, std::vector<float>& features) {
+        cv::Mat image = cv::imread(path.string(), cv::IMREAD_GRAYSCALE);
+        if (image.empty()) {
+            std::cerr << "Error: Unable to read image at path " << path << std::endl;
+            return false;
         }
-    }
-}
-
-
-void extractFeaturesAndSave(const std::string& inputDir, const std::string& outputFile) {
-    std::vector<std::pair<std::string, std::vector<float>>> featuresList;
-
-    for (const auto& entry : fs::directory_iterator(inputDir)) {
-        if (entry.path().extension() == ".jpg" || entry.path().extension() == ".png") {
-            cv::Mat image = cv::imread(entry.path().string(), cv::IMREAD_GRAYSCALE);
-            std::vector<float> features;
-            computeFeatures(image, features);
-
-            // Extract filename from the path
-            std::string filename = entry.path().filename().string();
-
-            featuresList.push_back({filename, features});
+        computeOrbCenterFeatures(image, features);
+        return true;
+    };
+
+    // Rows are written in directory order as soon as they are ready
+    bool headerWritten = false;
+    auto write = [&](const std::string& filename, const std::vector<float>& features) {
+        if (!headerWritten) {
+            csvFile << "filename,";
+            for (size_t i = 0; i < features.size(); ++i) {
+                csvFile << "feature_" << i << ",";
+            }
+            csvFile << "\n";
+            headerWritten = true;
         }
-    }
-
-    std::ofstream csvFile(outputFile);
-    csvFile << "filename,";
-    for (int i = 0; i < featuresList[0].second.size(); ++i) {
-        csvFile << "feature_" << i << ",";
-    }
-    csvFile << "\n";
 
-    for (const auto& row : featuresList) {
-        csvFile << row.first << ",";
-        for (const auto& feature : row.second) {
+        csvFile << filename << ",";
+        for (const auto& feature : features) {
             csvFile << feature << ",";
         }
         csvFile << "\n";
+    };
+
+    // With a store, unchanged images are copied from the previous store when incremental is set
+    if (storeFile.empty()) {
+        runIngestPipeline(inputDir, compute, write);
+    } else {
+        runStoreIngest(inputDir, storeFile, "orb-center", FS_NORM_NONE, compute, write, incremental);
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --incremental only extracts images that are new or changed since the last run,
+    // --chroma-bins N sets the bins per axis of the chromaticity histograms
+    bool incremental = false;
+    int chromaticityBins = CHROMATICITY_BINS;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--incremental") {
+            incremental = true;
+        } else if (arg == "--chroma-bins" && i + 1 < argc) {
+            chromaticityBins = std::atoi(argv[++i]);
+        }
+    }
+
     std::string inputDirectory = "../olympus";
     std::string outputFeatureFile = "../features.csv";
+    std::string outputStoreFile = "../features.bin";
+    std::string chromaticityStoreFile = "../features_chroma.bin";
+
+    extractFeaturesAndSave(inputDirectory, outputFeatureFile, outputStoreFile, incremental);
 
-    extractFeaturesAndSave(inputDirectory, outputFeatureFile);
+    // Chromaticity histograms used by histogramMatching and customImageRetrival
+    extractChromaticityFeaturesAndSave(inputDirectory, chromaticityStoreFile, incremental, chromaticityBins);
 
     return 0;
 }
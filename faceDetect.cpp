@@ -19,13 +19,13 @@
   cv::Mat grey  - a greyscale source image in which to detect faces
   std::vector<cv::Rect> &faces - a standard vector of cv::Rect rectangles indicating where faces were found
      if the length of the vector is zero, no faces were found
+
+  Returns -1 if the cascade file cannot be loaded. For many images or many threads
+  use the FaceDetector in faceDetector.h.
  */
 int detectFaces( cv::Mat &grey, std::vector<cv::Rect> &faces ) {
-  // a static variable to hold a half-size image
-  static cv::Mat half;
-  
-  // a static variable to hold the classifier
-  static cv::CascadeClassifier face_cascade;
+  // each thread holds its own classifier, they cannot be shared between threads
+  static thread_local cv::CascadeClassifier face_cascade;
 
   // the path to the haar cascade file
   static cv::String face_cascade_file(FACE_CASCADE_FILE);
@@ -33,14 +33,29 @@ int detectFaces( cv::Mat &grey, std::vector<cv::Rect> &faces ) {
   if( face_cascade.empty() ) {
     if( !face_cascade.load( face_cascade_file ) ) {
       printf("Unable to load face cascade file\n");
-      printf("Terminating\n");
-      exit(-1);
+      faces.clear();
+      return(-1);
     }
   }
 
+  return( detectFaces( face_cascade, grey, faces ) );
+}
+
+/*
+  Same detector with a caller-owned classifier and no shared buffers, so threads
+  that each hold their own classifier can run it concurrently.
+
+  Arguments:
+  cv::CascadeClassifier &classifier - a loaded face cascade
+  cv::Mat grey  - a greyscale source image in which to detect faces
+  std::vector<cv::Rect> &faces - a standard vector of cv::Rect rectangles indicating where faces were found
+ */
+int detectFaces( cv::CascadeClassifier &classifier, const cv::Mat &grey, std::vector<cv::Rect> &faces ) {
+  cv::Mat half;
+
   // clear the vector of faces
   faces.clear();
-  
+
   // cut the image size in half to reduce processing time
   cv::resize( grey, half, cv::Size(grey.cols/2, grey.rows/2) );
 
@@ -48,7 +63,7 @@ int detectFaces( cv::Mat &grey, std::vector<cv::Rect> &faces ) {
   cv::equalizeHist( half, half );
 
   // apply the Haar cascade detector
-  face_cascade.detectMultiScale( half, faces );
+  classifier.detectMultiScale( half, faces );
 
   // adjust the rectangle sizes back to the full size image
   for(int i=0;i<faces.size();i++) {
@@ -13,6 +13,7 @@
 
 // prototypes
 int detectFaces( cv::Mat &grey, std::vector<cv::Rect> &faces );
+int detectFaces( cv::CascadeClassifier &classifier, const cv::Mat &grey, std::vector<cv::Rect> &faces );
 int drawBoxes( cv::Mat &frame, std::vector<cv::Rect> &faces, int minWidth = 50, float scale = 1.0  );
 
 #endif
@@ -5,11 +5,11 @@
 #include "faceDetect.h"
 
 int detectFaces_greybg(cv::Mat &grey, std::vector<cv::Rect> &faces) {
-    // a static variable to hold a half-size image
-    static cv::Mat half;
+    // a half-size image
+    cv::Mat half;
 
-    // a static variable to hold the classifier
-    static cv::CascadeClassifier face_cascade;
+    // each thread holds its own classifier, they cannot be shared between threads
+    static thread_local cv::CascadeClassifier face_cascade;
 
     // the path to the haar cascade file
     static cv::String face_cascade_file(FACE_CASCADE_FILE);
@@ -17,8 +17,8 @@ int detectFaces_greybg(cv::Mat &grey, std::vector<cv::Rect> &faces) {
     if (face_cascade.empty()) {
         if (!face_cascade.load(face_cascade_file)) {
             printf("Unable to load face cascade file\n");
-            printf("Terminating\n");
-            exit(-1);
+            faces.clear();
+            return -1;
         }
     }
 
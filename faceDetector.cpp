@@ -0,0 +1,147 @@
+/**
+
+faceDetector.cpp
+Project 2
+
+Classifier pool and parallel batch detection for FaceDetector.
+
+**/
+
+#include "faceDetector.h"
+#include "faceDetect.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+int FaceDetector::load(const std::string& cascadeFile) {
+    auto classifier = std::make_unique<cv::CascadeClassifier>();
+    if (!classifier->load(cascadeFile)) {
+        std::cerr << "Error: Unable to load face cascade file " << cascadeFile << std::endl;
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cascadeFile_ = cascadeFile;
+    idle_.clear();
+    idle_.push_back(std::move(classifier));
+    return 0;
+}
+
+std::unique_ptr<cv::CascadeClassifier> FaceDetector::acquire() {
+    std::string cascadeFile;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            auto classifier = std::move(idle_.back());
+            idle_.pop_back();
+            return classifier;
+        }
+        cascadeFile = cascadeFile_;
+    }
+
+    // Loaded outside the lock so other threads can return theirs meanwhile
+    auto classifier = std::make_unique<cv::CascadeClassifier>();
+    if (cascadeFile.empty() || !classifier->load(cascadeFile)) {
+        std::cerr << "Error: Unable to load face cascade file " << cascadeFile << std::endl;
+        return nullptr;
+    }
+    return classifier;
+}
+
+void FaceDetector::release(std::unique_ptr<cv::CascadeClassifier> classifier) {
+    if (classifier) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(std::move(classifier));
+    }
+}
+
+// Detection on a classifier the caller owns for the duration of the call
+static bool detectWith(cv::CascadeClassifier& classifier, const cv::Mat& image, std::vector<cv::Rect>& faces) {
+    faces.clear();
+    if (image.empty()) {
+        return false;
+    }
+    if (image.channels() == 1) {
+        detectFaces(classifier, image, faces);
+    } else {
+        cv::Mat grey;
+        cv::cvtColor(image, grey, cv::COLOR_BGR2GRAY);
+        detectFaces(classifier, grey, faces);
+    }
+    return true;
+}
+
+int FaceDetector::detect(const cv::Mat& image, std::vector<cv::Rect>& faces) {
+    faces.clear();
+    if (!loaded() || image.empty()) {
+        return -1;
+    }
+    auto classifier = acquire();
+    if (!classifier) {
+        return -1;
+    }
+    detectWith(*classifier, image, faces);
+    release(std::move(classifier));
+    return 0;
+}
+
+template <typename Fn>
+int FaceDetector::runBatch(size_t count, int threads, Fn detectOne) {
+    int workerCount = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+    workerCount = static_cast<int>(std::min<size_t>(std::max(workerCount, 1), count));
+
+    // Images are handed out one at a time, since detection time varies a lot between images
+    std::atomic<size_t> next(0);
+    std::atomic<int> running(0);
+    auto work = [&] {
+        auto classifier = acquire();
+        if (!classifier) {
+            return;
+        }
+        ++running;
+        for (size_t i = next++; i < count; i = next++) {
+            detectOne(i, *classifier);
+        }
+        release(std::move(classifier));
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < workerCount; ++t) {
+        pool.emplace_back(work);
+    }
+    if (workerCount > 0) {
+        work();
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // Any worker that got a classifier drains the whole queue, so images are only skipped if none did
+    return count > 0 && running == 0 ? -1 : 0;
+}
+
+int FaceDetector::detectBatch(const std::vector<cv::Mat>& images, std::vector<FaceResult>& results, int threads) {
+    results.assign(images.size(), FaceResult());
+    if (!loaded()) {
+        return -1;
+    }
+    return runBatch(images.size(), threads, [&](size_t i, cv::CascadeClassifier& classifier) {
+        results[i].ok = detectWith(classifier, images[i], results[i].faces);
+    });
+}
+
+int FaceDetector::detectFiles(const std::vector<std::string>& paths, std::vector<FaceResult>& results, int threads) {
+    results.assign(paths.size(), FaceResult());
+    if (!loaded()) {
+        return -1;
+    }
+    return runBatch(paths.size(), threads, [&](size_t i, cv::CascadeClassifier& classifier) {
+        cv::Mat grey = cv::imread(paths[i], cv::IMREAD_GRAYSCALE);
+        if (grey.empty()) {
+            std::cerr << "Error: Unable to read image at path " << paths[i] << std::endl;
+            return;
+        }
+        results[i].ok = detectWith(classifier, grey, results[i].faces);
+    });
+}
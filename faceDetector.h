@@ -0,0 +1,69 @@
+/**
+
+faceDetector.h
+Project 2
+
+Thread-safe face detection. A FaceDetector loads the Haar cascade once to check it
+and then keeps a pool of classifier instances, one per thread that is detecting at
+the same time (a cv::CascadeClassifier cannot be shared between threads). detect()
+may be called from any number of threads; the batch calls spread a list of images
+or image files over a set of worker threads and return the rectangles per image.
+Detection is the same as detectFaces() in faceDetect.cpp: half-size, equalized,
+rectangles scaled back to the full image. Failures are reported, never exit().
+
+**/
+#ifndef FACEDETECTOR_H
+#define FACEDETECTOR_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Images are searched at 1/FACE_DETECT_SCALE resolution, as in detectFaces()
+#define FACE_DETECT_SCALE 2
+
+// Faces found in one image of a batch
+struct FaceResult {
+    bool ok = false; // false if the image was empty or could not be read
+    std::vector<cv::Rect> faces;
+};
+
+class FaceDetector {
+public:
+    FaceDetector() = default;
+    FaceDetector(const FaceDetector&) = delete;
+    FaceDetector& operator=(const FaceDetector&) = delete;
+
+    // Load the cascade file; returns -1 (and prints the error) if it cannot be read
+    int load(const std::string& cascadeFile);
+
+    bool loaded() const { return !cascadeFile_.empty(); }
+
+    // Faces in a greyscale or BGR image. Returns -1 if no cascade is loaded or the image is empty.
+    int detect(const cv::Mat& image, std::vector<cv::Rect>& faces);
+
+    // Faces in every image, on up to threads workers (0 uses every hardware thread).
+    // results[i] belongs to images[i]. Returns -1 if no cascade is loaded or no worker could load one.
+    int detectBatch(const std::vector<cv::Mat>& images, std::vector<FaceResult>& results, int threads = 0);
+
+    // Same for image files, which are decoded as greyscale by the workers
+    int detectFiles(const std::vector<std::string>& paths, std::vector<FaceResult>& results, int threads = 0);
+
+private:
+    // Borrow a classifier for the calling thread, loading another one if all are in use
+    std::unique_ptr<cv::CascadeClassifier> acquire();
+    void release(std::unique_ptr<cv::CascadeClassifier> classifier);
+
+    // Run detectOne(i, classifier) for i in [0, count) on up to threads workers.
+    // Returns -1 if no worker could acquire a classifier.
+    template <typename Fn>
+    int runBatch(size_t count, int threads, Fn detectOne);
+
+    std::string cascadeFile_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<cv::CascadeClassifier>> idle_;
+};
+
+#endif
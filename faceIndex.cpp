@@ -0,0 +1,172 @@
+/**
+
+faceIndex.cpp
+Project 2
+
+Reading, writing and lookups of the face-detection sidecar index.
+
+**/
+
+#include "faceIndex.h"
+#include "ingestManifest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+int FaceIndex::open(const std::string& indexFile, const std::string& cascadeFile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    indexFile_ = indexFile;
+    entries_.clear();
+    hits_ = misses_ = 0;
+    if (hashFileContents(cascadeFile, cascadeHash_) != 0) {
+        std::cerr << "Error: Unable to read face cascade file " << cascadeFile << std::endl;
+        return -1;
+    }
+
+    std::ifstream file(indexFile, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    FaceIndexHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, FACE_INDEX_MAGIC, sizeof(header.magic)) != 0 || header.version != FACE_INDEX_VERSION) {
+        std::cerr << "Warning: Ignoring unreadable face index " << indexFile << std::endl;
+        return 0;
+    }
+    if (header.cascadeHash != cascadeHash_ || header.detectScale != FACE_DETECT_SCALE) {
+        std::cout << "Face index " << indexFile << " was built with another cascade, detecting every image" << std::endl;
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < header.count; ++i) {
+        uint64_t contentHash = 0;
+        uint32_t faceCount = 0;
+        Entry entry;
+        file.read(reinterpret_cast<char*>(&contentHash), sizeof(contentHash));
+        file.read(reinterpret_cast<char*>(&entry.fileSize), sizeof(entry.fileSize));
+        file.read(reinterpret_cast<char*>(&faceCount), sizeof(faceCount));
+        if (!file || faceCount > 4096) {
+            break;
+        }
+        entry.faces.resize(faceCount);
+        for (auto& face : entry.faces) {
+            int32_t rect[4];
+            file.read(reinterpret_cast<char*>(rect), sizeof(rect));
+            face = cv::Rect(rect[0], rect[1], rect[2], rect[3]);
+        }
+        if (!file) {
+            break;
+        }
+        entries_[contentHash] = std::move(entry);
+    }
+    if (entries_.size() != header.count) {
+        std::cerr << "Warning: Face index " << indexFile << " is truncated, kept " << entries_.size() << " entries" << std::endl;
+    }
+    return 0;
+}
+
+int FaceIndex::save(bool prune) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t count = 0;
+    for (const auto& item : entries_) {
+        count += !prune || item.second.used;
+    }
+
+    FaceIndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FACE_INDEX_MAGIC, sizeof(header.magic));
+    header.version = FACE_INDEX_VERSION;
+    header.detectScale = FACE_DETECT_SCALE;
+    header.cascadeHash = cascadeHash_;
+    header.count = count;
+
+    std::string tempPath = indexFile_ + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write face index " << indexFile_ << std::endl;
+        return -1;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& item : entries_) {
+        if (prune && !item.second.used) {
+            continue;
+        }
+        uint32_t faceCount = static_cast<uint32_t>(item.second.faces.size());
+        file.write(reinterpret_cast<const char*>(&item.first), sizeof(item.first));
+        file.write(reinterpret_cast<const char*>(&item.second.fileSize), sizeof(item.second.fileSize));
+        file.write(reinterpret_cast<const char*>(&faceCount), sizeof(faceCount));
+        for (const auto& face : item.second.faces) {
+            int32_t rect[4] = {face.x, face.y, face.width, face.height};
+            file.write(reinterpret_cast<const char*>(rect), sizeof(rect));
+        }
+    }
+    file.close();
+    if (!file || std::rename(tempPath.c_str(), indexFile_.c_str()) != 0) {
+        std::cerr << "Error: Unable to write face index " << indexFile_ << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+bool FaceIndex::lookup(uint64_t contentHash, uint64_t fileSize, std::vector<cv::Rect>& faces) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(contentHash);
+    if (it == entries_.end() || it->second.fileSize != fileSize) {
+        ++misses_;
+        return false;
+    }
+    it->second.used = true;
+    faces = it->second.faces;
+    ++hits_;
+    return true;
+}
+
+void FaceIndex::insert(uint64_t contentHash, uint64_t fileSize, const std::vector<cv::Rect>& faces) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[contentHash];
+    entry.fileSize = fileSize;
+    entry.used = true;
+    entry.faces = faces;
+}
+
+size_t FaceIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+int indexedDetectFaces(FaceIndex& index, FaceDetector& detector, const fs::path& path, std::vector<cv::Rect>& faces,
+                       cv::Mat* decoded) {
+    faces.clear();
+    if (decoded) {
+        decoded->release();
+    }
+
+    std::error_code ec;
+    uint64_t fileSize = fs::file_size(path, ec);
+    uint64_t contentHash = 0;
+    if (ec || hashFileContents(path, contentHash) != 0) {
+        std::cerr << "Error: Unable to read image at path " << path << std::endl;
+        return -1;
+    }
+    if (index.lookup(contentHash, fileSize, faces)) {
+        return 0;
+    }
+
+    cv::Mat image = cv::imread(path.string(), decoded ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE);
+    if (image.empty()) {
+        std::cerr << "Error: Unable to read image at path " << path << std::endl;
+        return -1;
+    }
+    if (detector.detect(image, faces) != 0) {
+        return -1;
+    }
+    index.insert(contentHash, fileSize, faces);
+    if (decoded) {
+        *decoded = image;
+    }
+    return 0;
+}
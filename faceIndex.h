@@ -0,0 +1,94 @@
+/**
+
+faceIndex.h
+Project 2
+
+Persistent face-detection results. The rectangles the detector found in an image are
+kept in a sidecar index keyed by the image's content hash, together with the hash
+of the cascade file and the detection scale they were produced with. A later run
+looks an image up by hashing its bytes, which is far cheaper than decoding it and
+running the cascade, and only detects faces in images it has not seen. Editing an
+image changes its hash and so misses; a different cascade file or detection scale
+discards the whole index.
+
+File layout (native little-endian):
+  [FaceIndexHeader, 32 bytes]
+  count records of: uint64 contentHash, uint64 fileSize, uint32 faceCount,
+                    faceCount x int32[4] (x, y, width, height in full-image pixels)
+
+**/
+#ifndef FACEINDEX_H
+#define FACEINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "faceDetector.h"
+
+#define FACE_INDEX_MAGIC "CBIRFACE"
+#define FACE_INDEX_VERSION 1
+
+// Default sidecar beside the other stores
+#define FACE_INDEX_FILE "../faces.index"
+
+// On-disk header, exactly 32 bytes
+struct FaceIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t detectScale; // FACE_DETECT_SCALE of the detector that produced the entries
+    uint64_t cascadeHash; // FNV-1a of the cascade file
+    uint64_t count;
+};
+static_assert(sizeof(FaceIndexHeader) == 32, "FaceIndexHeader must be 32 bytes");
+
+// Lookups and inserts are thread-safe, so pipeline workers can share one index
+class FaceIndex {
+public:
+    FaceIndex() = default;
+    FaceIndex(const FaceIndex&) = delete;
+    FaceIndex& operator=(const FaceIndex&) = delete;
+
+    // Load indexFile for results of cascadeFile. A missing or unreadable index, or one
+    // written for another cascade or scale, starts out empty. Returns -1 only if the
+    // cascade file cannot be hashed.
+    int open(const std::string& indexFile, const std::string& cascadeFile);
+
+    // Rewrite the index file. With prune set, entries of images that were not looked
+    // up or inserted since open() (deleted or edited images) are dropped.
+    int save(bool prune = true);
+
+    // Faces recorded for the image content; false if it has not been detected yet
+    bool lookup(uint64_t contentHash, uint64_t fileSize, std::vector<cv::Rect>& faces);
+    void insert(uint64_t contentHash, uint64_t fileSize, const std::vector<cv::Rect>& faces);
+
+    size_t size() const;
+    long hits() const { return hits_; }
+    long misses() const { return misses_; }
+
+private:
+    struct Entry {
+        uint64_t fileSize = 0;
+        bool used = false;
+        std::vector<cv::Rect> faces;
+    };
+
+    std::string indexFile_;
+    uint64_t cascadeHash_ = 0;
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> entries_;
+    long hits_ = 0;
+    long misses_ = 0;
+};
+
+// Faces of the image file at path, taken from the index when its content is known and
+// otherwise detected with detector and recorded. On a miss the file is decoded; with
+// decoded set it is decoded in color and handed back so the caller need not read it
+// again (decoded is left empty on a hit). Returns -1 if the file cannot be read.
+int indexedDetectFaces(FaceIndex& index, FaceDetector& detector, const std::filesystem::path& path,
+                       std::vector<cv::Rect>& faces, cv::Mat* decoded = nullptr);
+
+#endif
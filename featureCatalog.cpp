@@ -0,0 +1,228 @@
+/**
+
+featureCatalog.cpp
+Project 2
+
+Row storage, name interning and the blocked scan kernels of FeatureCatalog.
+
+**/
+
+#include "featureCatalog.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+typedef void (*BlockKernel)(const float* query, const float* block, size_t dim, float* out);
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Distances of the CATALOG_BLOCK_ROWS rows of one block, each summed in dimension order
+template <CatalogMetric Metric>
+static void blockDistancesScalar(const float* query, const float* block, size_t dim, float* out) {
+    float acc[CATALOG_BLOCK_ROWS] = {0.0f};
+    for (size_t d = 0; d < dim; ++d) {
+        const float* column = block + d * CATALOG_BLOCK_ROWS;
+        for (size_t lane = 0; lane < CATALOG_BLOCK_ROWS; ++lane) {
+            float diff = query[d] - column[lane];
+            if (Metric == CATALOG_SSD) {
+                acc[lane] += diff * diff;
+            } else if (Metric == CATALOG_L1) {
+                acc[lane] += std::fabs(diff);
+            } else {
+                acc[lane] += query[d] < column[lane] ? query[d] : column[lane];
+            }
+        }
+    }
+    std::memcpy(out, acc, sizeof(acc));
+}
+
+#ifdef CBIR_X86_SIMD
+// Plain AVX2 without FMA, so the compiler cannot fuse the SSD multiply and add and the
+// sums stay identical to the scalar kernel. Four blocks are scanned together to keep
+// four independent add chains in flight; each row is still summed in dimension order.
+template <CatalogMetric Metric>
+__attribute__((target("avx2"))) static inline __m256 blockTerm(__m256 acc, __m256 q, const float* column) {
+    __m256 values = _mm256_load_ps(column);
+    if (Metric == CATALOG_SSD) {
+        __m256 diff = _mm256_sub_ps(q, values);
+        return _mm256_add_ps(acc, _mm256_mul_ps(diff, diff));
+    } else if (Metric == CATALOG_L1) {
+        return _mm256_add_ps(acc, _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(q, values)));
+    }
+    return _mm256_add_ps(acc, _mm256_min_ps(q, values));
+}
+
+template <CatalogMetric Metric>
+__attribute__((target("avx2"))) static void blockDistancesAvx2(const float* query, const float* block, size_t dim, float* out) {
+    static_assert(CATALOG_BLOCK_ROWS == 8, "one AVX2 register per block column");
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t d = 0; d < dim; ++d) {
+        acc = blockTerm<Metric>(acc, _mm256_set1_ps(query[d]), block + d * CATALOG_BLOCK_ROWS);
+    }
+    _mm256_storeu_ps(out, acc);
+}
+
+template <CatalogMetric Metric>
+__attribute__((target("avx2"))) static void blockDistances4Avx2(const float* query, const float* block, size_t dim, float* out) {
+    size_t blockFloats = dim * CATALOG_BLOCK_ROWS;
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps(), acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    for (size_t d = 0; d < dim; ++d) {
+        __m256 q = _mm256_set1_ps(query[d]);
+        const float* column = block + d * CATALOG_BLOCK_ROWS;
+        acc0 = blockTerm<Metric>(acc0, q, column);
+        acc1 = blockTerm<Metric>(acc1, q, column + blockFloats);
+        acc2 = blockTerm<Metric>(acc2, q, column + 2 * blockFloats);
+        acc3 = blockTerm<Metric>(acc3, q, column + 3 * blockFloats);
+    }
+    _mm256_storeu_ps(out, acc0);
+    _mm256_storeu_ps(out + CATALOG_BLOCK_ROWS, acc1);
+    _mm256_storeu_ps(out + 2 * CATALOG_BLOCK_ROWS, acc2);
+    _mm256_storeu_ps(out + 3 * CATALOG_BLOCK_ROWS, acc3);
+}
+#endif
+
+// Distances of four consecutive blocks, one block at a time
+template <CatalogMetric Metric>
+static void blockDistances4Scalar(const float* query, const float* block, size_t dim, float* out) {
+    for (size_t b = 0; b < 4; ++b) {
+        blockDistancesScalar<Metric>(query, block + b * dim * CATALOG_BLOCK_ROWS, dim, out + b * CATALOG_BLOCK_ROWS);
+    }
+}
+
+// Kernels for one block and for four consecutive blocks
+struct BlockKernels {
+    BlockKernel one;
+    BlockKernel four;
+};
+
+template <CatalogMetric Metric>
+static BlockKernels blockKernelsFor() {
+#ifdef CBIR_X86_SIMD
+    static const bool avx2 = detectSimdLevel() >= SIMD_AVX2;
+    if (avx2) {
+        return BlockKernels{blockDistancesAvx2<Metric>, blockDistances4Avx2<Metric>};
+    }
+#endif
+    return BlockKernels{blockDistancesScalar<Metric>, blockDistances4Scalar<Metric>};
+}
+
+static BlockKernels blockKernels(CatalogMetric metric) {
+    return metric == CATALOG_SSD  ? blockKernelsFor<CATALOG_SSD>()
+           : metric == CATALOG_L1 ? blockKernelsFor<CATALOG_L1>()
+                                  : blockKernelsFor<CATALOG_INTERSECTION>();
+}
+
+FeatureCatalog::AlignedFloats FeatureCatalog::allocate(size_t floats) {
+    size_t bytes = alignUp(std::max<size_t>(floats, 1) * sizeof(float), FEATURE_STORE_ALIGN);
+    float* memory = static_cast<float*>(std::aligned_alloc(FEATURE_STORE_ALIGN, bytes));
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return AlignedFloats(memory);
+}
+
+void FeatureCatalog::clear(uint32_t dim) {
+    dim_ = dim;
+    stride_ = alignUp(dim, FEATURE_STORE_ALIGN / sizeof(float));
+    capacity_ = 0;
+    matrix_.reset();
+    arena_.clear();
+    offsets_.assign(1, 0);
+    index_.clear();
+    blocks_.reset();
+    blockRows_ = 0;
+}
+
+void FeatureCatalog::reserveRows(size_t rows) {
+    if (rows <= capacity_) {
+        return;
+    }
+    size_t capacity = std::max({rows, capacity_ * 2, static_cast<size_t>(64)});
+    AlignedFloats grown = allocate(capacity * stride_);
+    if (matrix_) {
+        std::memcpy(grown.get(), matrix_.get(), capacity_ * stride_ * sizeof(float));
+    }
+    matrix_ = std::move(grown);
+    capacity_ = capacity;
+}
+
+long FeatureCatalog::add(std::string_view name, const float* values, size_t n) {
+    if (dim_ == 0 && size() == 0) {
+        clear(static_cast<uint32_t>(n));
+    }
+
+    size_t id = size();
+    arena_.insert(arena_.end(), name.begin(), name.end());
+    offsets_.push_back(arena_.size());
+    if (!index_.insert(*this, static_cast<uint32_t>(id))) {
+        offsets_.pop_back();
+        arena_.resize(offsets_.back());
+        return -1;
+    }
+    if (n != dim_) {
+        std::cerr << "Warning: " << name << " has " << n << " features, expected " << dim_ << "; padding/truncating" << std::endl;
+    }
+
+    // Rows are zero padded to the stride so every row starts on an aligned boundary
+    reserveRows(id + 1);
+    float* row = matrix_.get() + id * stride_;
+    size_t copied = std::min<size_t>(n, dim_);
+    std::copy(values, values + copied, row);
+    std::fill(row + copied, row + stride_, 0.0f);
+    return static_cast<long>(id);
+}
+
+void FeatureCatalog::buildBlocks() {
+    size_t numBlocks = (size() + CATALOG_BLOCK_ROWS - 1) / CATALOG_BLOCK_ROWS;
+    size_t blockFloats = static_cast<size_t>(dim_) * CATALOG_BLOCK_ROWS;
+    blocks_ = allocate(numBlocks * blockFloats);
+
+    // The unused lanes of the last block are zero rows that scan() skips
+    std::fill(blocks_.get(), blocks_.get() + numBlocks * blockFloats, 0.0f);
+    for (size_t id = 0; id < size(); ++id) {
+        float* block = blocks_.get() + id / CATALOG_BLOCK_ROWS * blockFloats;
+        size_t lane = id % CATALOG_BLOCK_ROWS;
+        const float* values = row(id);
+        for (size_t d = 0; d < dim_; ++d) {
+            block[d * CATALOG_BLOCK_ROWS + lane] = values[d];
+        }
+    }
+    blockRows_ = size();
+}
+
+void FeatureCatalog::scan(const float* query, CatalogMetric metric, long excludeId, TopK& best) const {
+    if (hasBlocks()) {
+        BlockKernels kernels = blockKernels(metric);
+        size_t blockFloats = static_cast<size_t>(dim_) * CATALOG_BLOCK_ROWS;
+        size_t numBlocks = (size() + CATALOG_BLOCK_ROWS - 1) / CATALOG_BLOCK_ROWS;
+        float distances[4 * CATALOG_BLOCK_ROWS];
+        for (size_t b = 0; b < numBlocks;) {
+            size_t blocks = numBlocks - b >= 4 ? 4 : 1;
+            (blocks == 4 ? kernels.four : kernels.one)(query, blocks_.get() + b * blockFloats, dim_, distances);
+            size_t first = b * CATALOG_BLOCK_ROWS;
+            size_t last = std::min(first + blocks * CATALOG_BLOCK_ROWS, size());
+            b += blocks;
+            for (size_t id = first; id < last; ++id) {
+                if (static_cast<long>(id) != excludeId) {
+                    best.push(static_cast<uint32_t>(id), distances[id - first]);
+                }
+            }
+        }
+        return;
+    }
+
+    for (size_t id = 0; id < size(); ++id) {
+        if (static_cast<long>(id) == excludeId) {
+            continue;
+        }
+        float score = metric == CATALOG_SSD  ? ssdDistance(query, row(id), dim_)
+                      : metric == CATALOG_L1 ? l1Distance(query, row(id), dim_)
+                                             : histogramIntersection(query, row(id), dim_);
+        best.push(static_cast<uint32_t>(id), score);
+    }
+}
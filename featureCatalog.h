@@ -0,0 +1,96 @@
+/**
+
+featureCatalog.h
+Project 2
+
+In-memory counterpart of the feature store for features that are computed rather
+than loaded, such as the per-scale passes of decodeScaleReport. Filenames are
+interned once in a single character arena and mapped to dense uint32 ids through a
+NameIndex, and the vectors live in one 64-byte aligned row-major matrix, so nothing
+in a scan chases per-image heap allocations or compares strings.
+
+buildBlocks() adds a column-blocked copy for full scans: rows are grouped
+CATALOG_BLOCK_ROWS at a time and each group is stored dimension-major, so one pass
+over a block yields the distances of all of its rows with one vector load per
+dimension. Blocked sums are accumulated per row in dimension order, so the scalar
+and AVX2 blocked kernels return identical distances; they may differ from the row
+kernels of distanceKernels.h in the last bits.
+
+**/
+#ifndef FEATURECATALOG_H
+#define FEATURECATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "featureStore.h"
+#include "topK.h"
+
+#define CATALOG_BLOCK_ROWS 8
+
+enum CatalogMetric {
+    CATALOG_SSD,
+    CATALOG_L1,
+    CATALOG_INTERSECTION // a similarity, larger is better
+};
+
+class FeatureCatalog {
+public:
+    FeatureCatalog() = default;
+    FeatureCatalog(const FeatureCatalog&) = delete;
+    FeatureCatalog& operator=(const FeatureCatalog&) = delete;
+    FeatureCatalog(FeatureCatalog&&) = default;
+    FeatureCatalog& operator=(FeatureCatalog&&) = default;
+
+    // Drop every row; dim = 0 takes the dimension from the first added row
+    void clear(uint32_t dim = 0);
+
+    // Intern name and copy its n values (padded or truncated to dim). Returns the new
+    // id, or -1 if name is already in the catalog.
+    long add(std::string_view name, const float* values, size_t n);
+    long add(std::string_view name, const std::vector<float>& values) { return add(name, values.data(), values.size()); }
+
+    // Returns the id of the given filename or -1 if it is not in the catalog
+    long find(std::string_view filename) const { return index_.find(*this, filename); }
+
+    size_t size() const { return offsets_.size() - 1; }
+    uint32_t dim() const { return dim_; }
+    size_t rowStride() const { return stride_; } // floats between consecutive rows
+    const float* row(size_t id) const { return matrix_.get() + id * stride_; }
+    std::string_view name(size_t id) const {
+        return std::string_view(arena_.data() + offsets_[id], offsets_[id + 1] - offsets_[id]);
+    }
+
+    // Build (or rebuild after adds) the column-blocked copy used by scan()
+    void buildBlocks();
+    bool hasBlocks() const { return blockRows_ == size() && size() > 0; }
+
+    // Push every row except excludeId (-1 for none) into best, which must rank by the
+    // metric's direction. Uses the blocked copy when it is current.
+    void scan(const float* query, CatalogMetric metric, long excludeId, TopK& best) const;
+
+private:
+    struct FreeDeleter {
+        void operator()(float* p) const { std::free(p); }
+    };
+    typedef std::unique_ptr<float[], FreeDeleter> AlignedFloats;
+
+    static AlignedFloats allocate(size_t floats);
+    void reserveRows(size_t rows);
+
+    uint32_t dim_ = 0;
+    size_t stride_ = 0;
+    size_t capacity_ = 0; // rows allocated in matrix_
+    AlignedFloats matrix_;
+    std::vector<char> arena_;
+    std::vector<size_t> offsets_{0}; // size()+1 offsets into arena_
+    NameIndex index_;
+
+    AlignedFloats blocks_; // ceil(size / CATALOG_BLOCK_ROWS) blocks of dim x CATALOG_BLOCK_ROWS floats
+    size_t blockRows_ = 0; // rows covered by blocks_
+};
+
+#endif
@@ -0,0 +1,443 @@
+/**
+
+featureMatching_usingResNet18.cpp  
+Project 2  
+  
+Created by Ruohe Zhou and Rucha Pendharkar on 2/8/24
+
+This code is used for Task 5. The code aims return top three similar images computed from the
+features with DNN Embeddings. With --batch it answers a whole list of targets in one pass;
+--ivf, --hnsw and --pq answer from an approximate index instead of scanning every embedding.
+
+
+**/
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include "featureStore.h"
+#include "distanceKernels.h"
+#include "topK.h"
+#include "ivfIndex.h"
+#include "hnswIndex.h"
+#include "pqIndex.h"
+#include "searchRecall.h"
+
+namespace fs = std::filesystem;
+
+// normFeature1 is the precomputed L2 norm of feature1, so only feature2 is normed per pair
+float computeCosineDistance(const float* feature1, float normFeature1, const float* feature2, size_t dim) {
+    float distance = cosineDistance(feature1, feature2, dim, normFeature1);
+
+    // Avoid division by zero
+    if (distance < 0.0f) {
+        std::cerr << "Error: Division by zero in cosine distance calculation.\n";
+        return -1.0;  // Invalid distance
+    }
+    return distance;
+}
+
+std::vector<std::pair<std::string, float>> findMatches(const std::string& targetFilename, const FeatureStore& store, int n) {
+    std::vector<std::pair<std::string, float>> distances;
+
+    // Find target features in the store
+    long targetIndex = store.find(targetFilename);
+    if (targetIndex < 0) {
+        std::cerr << "Error: Target image not found in the feature file.\n";
+        return distances;
+    }
+    const float* targetFeatures = store.row(targetIndex);
+    float targetNorm = l2Norm(targetFeatures, store.dim());
+
+    // Scan every other image, keeping the n smallest distances
+    TopK bestMatches(std::max(n, 0));
+    for (size_t i = 0; i < store.size(); ++i) {
+        if (static_cast<long>(i) == targetIndex) {
+            continue; // Skip the target image itself
+        }
+
+        float distance = computeCosineDistance(targetFeatures, targetNorm, store.row(i), store.dim());
+        if (distance >= 0.0f) {
+            bestMatches.push(static_cast<uint32_t>(i), distance);
+        }
+    }
+
+    for (const auto& match : bestMatches.sorted()) {
+        distances.push_back({std::string(store.name(match.id)), match.score});
+    }
+    return distances;
+}
+
+// Answer many targets together. The L2-normalized query embeddings are stacked into a
+// matrix and multiplied against blocks of the normalized database with cv::gemm, so
+// each database block is read once per query batch instead of once per query.
+std::vector<std::vector<std::pair<std::string, float>>> findMatchesBatch(const std::vector<std::string>& targetFilenames, const FeatureStore& normalizedStore, int n) {
+    const int queryBlock = 256;   // queries multiplied together
+    const int databaseBlock = 4096; // database rows per gemm call
+    const int dim = static_cast<int>(normalizedStore.dim());
+    const int rows = static_cast<int>(normalizedStore.size());
+
+    std::vector<std::vector<std::pair<std::string, float>>> results(targetFilenames.size());
+
+    // The database rows are used in place; the stride covers the store's row padding
+    cv::Mat database(rows, dim, CV_32F, const_cast<float*>(normalizedStore.row(0)), normalizedStore.rowStride());
+
+    for (size_t first = 0; first < targetFilenames.size(); first += queryBlock) {
+        size_t count = std::min(targetFilenames.size() - first, static_cast<size_t>(queryBlock));
+
+        // Stack the normalized query rows; unknown targets keep an empty result
+        std::vector<long> targetIndices(count);
+        cv::Mat queries(static_cast<int>(count), dim, CV_32F, cv::Scalar(0));
+        for (size_t q = 0; q < count; ++q) {
+            targetIndices[q] = normalizedStore.find(targetFilenames[first + q]);
+            if (targetIndices[q] < 0) {
+                std::cerr << "Error: Target image " << targetFilenames[first + q] << " not found in the feature file.\n";
+                continue;
+            }
+            std::copy(normalizedStore.row(targetIndices[q]), normalizedStore.row(targetIndices[q]) + dim, queries.ptr<float>(static_cast<int>(q)));
+        }
+
+        // Cosine similarity is the dot product of unit vectors, so larger is better
+        std::vector<TopK> bestMatches(count, TopK(std::max(n, 0), true));
+        cv::Mat scores;
+        for (int start = 0; start < rows; start += databaseBlock) {
+            cv::Mat block = database.rowRange(start, std::min(rows, start + databaseBlock));
+            cv::gemm(queries, block, 1.0, cv::noArray(), 0.0, scores, cv::GEMM_2_T);
+
+            for (size_t q = 0; q < count; ++q) {
+                if (targetIndices[q] < 0) {
+                    continue;
+                }
+                const float* row = scores.ptr<float>(static_cast<int>(q));
+                for (int j = 0; j < scores.cols; ++j) {
+                    if (start + j != targetIndices[q]) {
+                        bestMatches[q].push(static_cast<uint32_t>(start + j), row[j]);
+                    }
+                }
+            }
+        }
+
+        // Report the same angular distance as computeCosineDistance
+        for (size_t q = 0; q < count; ++q) {
+            for (const auto& match : bestMatches[q].sorted()) {
+                float cosine = std::max(-1.0f, std::min(1.0f, match.score));
+                results[first + q].push_back({std::string(normalizedStore.name(match.id)), std::acos(cosine)});
+            }
+        }
+    }
+
+    return results;
+}
+
+// Approximate search through the IVF index, scanning only the nprobe nearest lists
+std::vector<std::pair<std::string, float>> findMatchesIvf(const std::string& targetFilename, const FeatureStore& normalizedStore, const IvfIndex& index, int nprobe, int n) {
+    std::vector<std::pair<std::string, float>> distances;
+
+    long targetIndex = normalizedStore.find(targetFilename);
+    if (targetIndex < 0) {
+        std::cerr << "Error: Target image not found in the feature file.\n";
+        return distances;
+    }
+
+    TopK bestMatches(std::max(n, 0), true);
+    index.search(normalizedStore.row(targetIndex), nprobe, bestMatches, targetIndex);
+
+    for (const auto& match : bestMatches.sorted()) {
+        float cosine = std::max(-1.0f, std::min(1.0f, match.score));
+        distances.push_back({std::string(normalizedStore.name(match.id)), std::acos(cosine)});
+    }
+    return distances;
+}
+
+// Approximate search through the HNSW graph
+std::vector<std::pair<std::string, float>> findMatchesHnsw(const std::string& targetFilename, const FeatureStore& normalizedStore, const HnswIndex& index, int n) {
+    std::vector<std::pair<std::string, float>> distances;
+
+    long targetIndex = normalizedStore.find(targetFilename);
+    if (targetIndex < 0) {
+        std::cerr << "Error: Target image not found in the feature file.\n";
+        return distances;
+    }
+
+    TopK bestMatches(std::max(n, 0), true);
+    index.search(normalizedStore.row(targetIndex), bestMatches, targetIndex);
+
+    for (const auto& match : bestMatches.sorted()) {
+        float cosine = std::max(-1.0f, std::min(1.0f, match.score));
+        distances.push_back({std::string(normalizedStore.name(match.id)), std::acos(cosine)});
+    }
+    return distances;
+}
+
+// Approximate search over the product-quantized codes, optionally re-ranking the best
+// rerank candidates against the full-precision embeddings
+std::vector<std::pair<std::string, float>> findMatchesPq(const std::string& targetFilename, const FeatureStore& normalizedStore, const PqIndex& index, int rerank, int n) {
+    std::vector<std::pair<std::string, float>> distances;
+
+    long targetIndex = normalizedStore.find(targetFilename);
+    if (targetIndex < 0) {
+        std::cerr << "Error: Target image not found in the feature file.\n";
+        return distances;
+    }
+
+    TopK bestMatches(std::max(n, 0), true);
+    index.search(normalizedStore.row(targetIndex), bestMatches, targetIndex, rerank, &normalizedStore);
+
+    for (const auto& match : bestMatches.sorted()) {
+        float cosine = std::max(-1.0f, std::min(1.0f, match.score));
+        distances.push_back({std::string(normalizedStore.name(match.id)), std::acos(cosine)});
+    }
+    return distances;
+}
+
+// The unit-norm copy of the embeddings is written once and mapped on later runs; like the
+// quantized copies it is only trusted while it is newer than the store and matches its shape
+int openNormalizedStore(const FeatureStore& store, const std::string& storeFile, FeatureStore& normalizedStore,
+                        const std::string& normalizedStoreFile) {
+    std::error_code ec, normalizedEc;
+    auto storeTime = fs::last_write_time(storeFile, ec);
+    auto normalizedTime = fs::last_write_time(normalizedStoreFile, normalizedEc);
+    if (!ec && !normalizedEc && normalizedTime >= storeTime && normalizedStore.open(normalizedStoreFile) == 0 &&
+        normalizedStore.normalization() == FS_NORM_L2 && normalizedStore.size() == store.size() &&
+        normalizedStore.dim() == store.dim()) {
+        return 0;
+    }
+    normalizedStore.close();
+
+    std::cout << "Writing normalized copy " << normalizedStoreFile << "\n";
+    if (writeL2NormalizedStore(store, normalizedStoreFile) != 0) {
+        return -1;
+    }
+    return normalizedStore.open(normalizedStoreFile);
+}
+
+// The IVF index for a given list count is built once and loaded on later runs, while it is
+// newer than the store it groups
+int openIvfIndex(const FeatureStore& normalizedStore, const std::string& normalizedStoreFile, IvfIndex& index,
+                 const std::string& indexFile, int numLists) {
+    std::error_code ec, indexEc;
+    auto storeTime = fs::last_write_time(normalizedStoreFile, ec);
+    auto indexTime = fs::last_write_time(indexFile, indexEc);
+    if (!ec && !indexEc && indexTime >= storeTime && index.load(indexFile, normalizedStore) == 0 &&
+        index.numLists() == numLists) {
+        return 0;
+    }
+    std::cout << "Building IVF index with " << numLists << " lists\n";
+    if (index.build(normalizedStore, numLists) != 0) {
+        return -1;
+    }
+    index.save(indexFile);
+    return 0;
+}
+
+// The HNSW graph is loaded from disk and only embeddings added to the store since it
+// was saved are inserted; a graph built from a different store is rebuilt from scratch
+int openHnswIndex(const FeatureStore& normalizedStore, HnswIndex& index, const std::string& indexFile, const HnswParams& params) {
+    long inserted = -1;
+    if (index.load(indexFile) == 0 && index.params().M == params.M && index.params().efConstruction == params.efConstruction) {
+        inserted = insertStoreRows(index, normalizedStore);
+    }
+    if (inserted < 0) {
+        std::cout << "Building HNSW index with M " << params.M << ", efConstruction " << params.efConstruction << "\n";
+        index = HnswIndex(normalizedStore.dim(), params);
+        inserted = insertStoreRows(index, normalizedStore);
+    }
+    index.setEfSearch(params.efSearch);
+    if (inserted > 0) {
+        index.save(indexFile);
+    }
+    return 0;
+}
+
+// The PQ codes for a given subspace count are trained once and loaded on later runs. The index
+// holds no filenames, so it is only trusted while it is newer than the store it encodes.
+int openPqIndex(const FeatureStore& normalizedStore, const std::string& normalizedStoreFile, PqIndex& index,
+                const std::string& indexFile, int numSubspaces) {
+    std::error_code ec, indexEc;
+    auto storeTime = fs::last_write_time(normalizedStoreFile, ec);
+    auto indexTime = fs::last_write_time(indexFile, indexEc);
+    if (!ec && !indexEc && indexTime >= storeTime && index.load(indexFile) == 0 && index.numSubspaces() == numSubspaces &&
+        index.size() == normalizedStore.size() && index.dim() == normalizedStore.dim()) {
+        return 0;
+    }
+    std::cout << "Training PQ index with " << numSubspaces << " subspaces\n";
+    if (index.build(normalizedStore, numSubspaces) != 0) {
+        return -1;
+    }
+    index.save(indexFile);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string featureFile = "/home/rucha/CS5330/Project2/ResNet18_olym.csv"; 
+    std::string storeFile = "/home/rucha/CS5330/Project2/ResNet18_olym.bin";
+    std::string normalizedStoreFile = "/home/rucha/CS5330/Project2/ResNet18_olym_l2.bin";
+
+    // Map the embeddings, importing them from the CSV file on first use
+    FeatureStore store;
+    if (loadFeatureStore(store, storeFile, featureFile, "resnet18", FS_NORM_NONE) != 0) {
+        return 1;
+    }
+
+    // Batch mode: --batch <file with one target filename per line> [numMatches]
+    if (argc > 2 && std::string(argv[1]) == "--batch") {
+        int numMatches = argc > 3 ? std::atoi(argv[3]) : 3;
+
+        std::vector<std::string> targets;
+        std::ifstream targetList(argv[2]);
+        if (!targetList.is_open()) {
+            std::cerr << "Error: Unable to open target list " << argv[2] << ".\n";
+            return 1;
+        }
+        for (std::string line; std::getline(targetList, line);) {
+            if (!line.empty()) {
+                targets.push_back(line);
+            }
+        }
+
+        FeatureStore normalizedStore;
+        if (openNormalizedStore(store, storeFile, normalizedStore, normalizedStoreFile) != 0) {
+            return 1;
+        }
+
+        auto batchMatches = findMatchesBatch(targets, normalizedStore, numMatches);
+        for (size_t q = 0; q < targets.size(); ++q) {
+            std::cout << "Top " << numMatches << " Matches for " << targets[q] << ":\n";
+            for (const auto& match : batchMatches[q]) {
+                std::cout << "Filename: " << match.first << ",  Distance: " << match.second << "\n";
+            }
+        }
+        return 0;
+    }
+
+    // IVF mode: --ivf <numLists> <nprobe> [target] [numMatches]
+    //           --ivf-recall <numLists> <nprobe> [numMatches] [numQueries]
+    if (argc > 3 && (std::string(argv[1]) == "--ivf" || std::string(argv[1]) == "--ivf-recall")) {
+        int numLists = std::atoi(argv[2]);
+        int nprobe = std::atoi(argv[3]);
+        std::string indexFile = "/home/rucha/CS5330/Project2/ResNet18_olym_" + std::to_string(numLists) + ".ivf";
+
+        FeatureStore normalizedStore;
+        IvfIndex index;
+        if (openNormalizedStore(store, storeFile, normalizedStore, normalizedStoreFile) != 0 ||
+            openIvfIndex(normalizedStore, normalizedStoreFile, index, indexFile, numLists) != 0) {
+            return 1;
+        }
+
+        if (std::string(argv[1]) == "--ivf-recall") {
+            int numMatches = argc > 4 ? std::atoi(argv[4]) : 10;
+            int numQueries = argc > 5 ? std::atoi(argv[5]) : 100;
+            double meanQueryMs = 0.0;
+            float recall = measureIvfRecall(index, normalizedStore, numMatches, nprobe, numQueries, &meanQueryMs);
+            std::cout << "IVF lists " << numLists << ", nprobe " << nprobe << ": recall@" << numMatches << " = " << recall
+                      << ", mean query " << meanQueryMs << " ms\n";
+            return 0;
+        }
+
+        std::string targetFilename = argc > 4 ? argv[4] : "pic.0734.jpg";
+        int numMatches = argc > 5 ? std::atoi(argv[5]) : 3;
+        auto matches = findMatchesIvf(targetFilename, normalizedStore, index, nprobe, numMatches);
+
+        std::cout << "Top " << numMatches << " Matches for " << targetFilename << ":\n";
+        for (const auto& match : matches) {
+            std::cout << "Filename: " << match.first << ",  Distance: " << match.second << "\n";
+        }
+        return 0;
+    }
+
+    // HNSW mode: --hnsw <M> <efConstruction> <efSearch> [target] [numMatches]
+    //            --hnsw-recall <M> <efConstruction> <efSearch> [numMatches] [numQueries]
+    if (argc > 4 && (std::string(argv[1]) == "--hnsw" || std::string(argv[1]) == "--hnsw-recall")) {
+        HnswParams params;
+        params.M = std::atoi(argv[2]);
+        params.efConstruction = std::atoi(argv[3]);
+        params.efSearch = std::atoi(argv[4]);
+        std::string indexFile = "/home/rucha/CS5330/Project2/ResNet18_olym_M" + std::to_string(params.M) + "_ef" +
+                                std::to_string(params.efConstruction) + ".hnsw";
+
+        FeatureStore normalizedStore;
+        HnswIndex index;
+        if (openNormalizedStore(store, storeFile, normalizedStore, normalizedStoreFile) != 0 ||
+            openHnswIndex(normalizedStore, index, indexFile, params) != 0) {
+            return 1;
+        }
+
+        if (std::string(argv[1]) == "--hnsw-recall") {
+            int numMatches = argc > 5 ? std::atoi(argv[5]) : 10;
+            int numQueries = argc > 6 ? std::atoi(argv[6]) : 100;
+            double meanQueryMs = 0.0;
+            float recall = measureSearchRecall(normalizedStore, numMatches, numQueries, [&](const float* query, long excludeId, TopK& result) {
+                index.search(query, result, excludeId);
+            }, &meanQueryMs);
+            std::cout << "HNSW M " << params.M << ", efConstruction " << params.efConstruction << ", efSearch " << params.efSearch
+                      << ": recall@" << numMatches << " = " << recall << ", mean query " << meanQueryMs << " ms\n";
+            return 0;
+        }
+
+        std::string targetFilename = argc > 5 ? argv[5] : "pic.0734.jpg";
+        int numMatches = argc > 6 ? std::atoi(argv[6]) : 3;
+        auto matches = findMatchesHnsw(targetFilename, normalizedStore, index, numMatches);
+
+        std::cout << "Top " << numMatches << " Matches for " << targetFilename << ":\n";
+        for (const auto& match : matches) {
+            std::cout << "Filename: " << match.first << ",  Distance: " << match.second << "\n";
+        }
+        return 0;
+    }
+
+    // PQ mode: --pq <numSubspaces> <rerank> [target] [numMatches]
+    //          --pq-recall <numSubspaces> <rerank> [numMatches] [numQueries]
+    if (argc > 3 && (std::string(argv[1]) == "--pq" || std::string(argv[1]) == "--pq-recall")) {
+        int numSubspaces = std::atoi(argv[2]);
+        int rerank = std::atoi(argv[3]);
+        std::string indexFile = "/home/rucha/CS5330/Project2/ResNet18_olym_" + std::to_string(numSubspaces) + ".pq";
+
+        FeatureStore normalizedStore;
+        PqIndex index;
+        if (openNormalizedStore(store, storeFile, normalizedStore, normalizedStoreFile) != 0 ||
+            openPqIndex(normalizedStore, normalizedStoreFile, index, indexFile, numSubspaces) != 0) {
+            return 1;
+        }
+
+        if (std::string(argv[1]) == "--pq-recall") {
+            int numMatches = argc > 4 ? std::atoi(argv[4]) : 10;
+            int numQueries = argc > 5 ? std::atoi(argv[5]) : 100;
+            double meanQueryMs = 0.0;
+            float recall = measureSearchRecall(normalizedStore, numMatches, numQueries, [&](const float* query, long excludeId, TopK& result) {
+                index.search(query, result, excludeId, rerank, &normalizedStore);
+            }, &meanQueryMs);
+            std::cout << "PQ subspaces " << numSubspaces << ", rerank " << rerank << ": recall@" << numMatches << " = " << recall
+                      << ", mean query " << meanQueryMs << " ms, codes " << index.codeBytes() << " bytes vs "
+                      << normalizedStore.size() * normalizedStore.dim() * sizeof(float) << " bytes of floats\n";
+            return 0;
+        }
+
+        std::string targetFilename = argc > 4 ? argv[4] : "pic.0734.jpg";
+        int numMatches = argc > 5 ? std::atoi(argv[5]) : 3;
+        auto matches = findMatchesPq(targetFilename, normalizedStore, index, rerank, numMatches);
+
+        std::cout << "Top " << numMatches << " Matches for " << targetFilename << ":\n";
+        for (const auto& match : matches) {
+            std::cout << "Filename: " << match.first << ",  Distance: " << match.second << "\n";
+        }
+        return 0;
+    }
+
+    // Optional arguments: target filename and number of matches
+    std::string targetFilename = argc > 1 ? argv[1] : "pic.0734.jpg";
+    int numMatches = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    auto matches = findMatches(targetFilename, store, numMatches);
+
+    std::cout << "Top " << numMatches << " Matches for " << targetFilename << ":\n";
+    for (const auto& match : matches) {
+        std::cout << "Filename: " << match.first << ",  Distance: " << match.second << "\n";
+    }
+
+    return 0;
+}
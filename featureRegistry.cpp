@@ -0,0 +1,141 @@
+/**
+
+featureRegistry.cpp
+Project 2
+
+Built-in feature computers and the shared image intermediates.
+
+**/
+
+#include "featureRegistry.h"
+#include "chromaticity.h"
+#include "featureStore.h"
+#include "imageFeatures.h"
+#include "spatialHistogram.h"
+
+#include <iostream>
+
+ImageContext::ImageContext(const cv::Mat& image) {
+    if (image.channels() == 1) {
+        gray_ = image;
+    } else {
+        bgr_ = image;
+    }
+}
+
+const cv::Mat& ImageContext::gray() {
+    if (gray_.empty() && !bgr_.empty()) {
+        cv::cvtColor(bgr_, gray_, cv::COLOR_BGR2GRAY);
+    }
+    return gray_;
+}
+
+const cv::Mat& ImageContext::hsv() {
+    if (hsv_.empty() && !bgr_.empty()) {
+        cv::cvtColor(bgr_, hsv_, cv::COLOR_BGR2HSV);
+    }
+    return hsv_;
+}
+
+static bool computeOrbCenter(ImageContext& image, std::vector<float>& features) {
+    // The center region often has no keypoints; an empty descriptor set is a valid result
+    computeOrbCenterFeatures(image.gray(), features);
+    return true;
+}
+
+static bool computeRgbTopBottom(ImageContext& image, std::vector<float>& features) {
+    static const SpatialLayout topBottom = [] {
+        SpatialLayout layout;
+        parseSpatialLayout(DEFAULT_SPATIAL_LAYOUT, layout);
+        return layout;
+    }();
+    return computeLayoutHistograms(image.bgr(), topBottom, features);
+}
+
+static bool computeHsvSobel(ImageContext& image, std::vector<float>& features) {
+    std::vector<float> textureHistogram;
+    features.clear();
+    computeColorTextureHistograms(image.bgr(), features, textureHistogram);
+    if (features.empty() || textureHistogram.empty()) {
+        return false;
+    }
+    features.insert(features.end(), textureHistogram.begin(), textureHistogram.end());
+    return true;
+}
+
+static bool computeChromaticity(ImageContext& image, std::vector<float>& features) {
+    computeChromaticityHistogram(image.bgr(), features);
+    return !features.empty();
+}
+
+static std::vector<FeatureComputer>& registry() {
+    static std::vector<FeatureComputer> computers = {
+        // The ORB descriptor of a fixed 7x7 center patch depends on resolution, the histograms do not
+        {"orb-center", FS_NORM_NONE, false, false, "ssd", computeOrbCenter},
+        {"rgb-top-bottom", FS_NORM_MINMAX, true, true, "l1", computeRgbTopBottom},
+        {"hsv-sobel", FS_NORM_MINMAX, true, true, "l1", computeHsvSobel},
+        {"chromaticity-rg", FS_NORM_L1, true, true, "intersection", computeChromaticity},
+    };
+    return computers;
+}
+
+const std::vector<FeatureComputer>& featureComputers() {
+    return registry();
+}
+
+const FeatureComputer* findFeatureComputer(const std::string& featureType) {
+    for (const auto& computer : registry()) {
+        if (computer.featureType == featureType) {
+            return &computer;
+        }
+    }
+    return nullptr;
+}
+
+void registerFeatureComputer(const FeatureComputer& computer) {
+    for (auto& existing : registry()) {
+        if (existing.featureType == computer.featureType) {
+            existing = computer;
+            return;
+        }
+    }
+    registry().push_back(computer);
+}
+
+int reducedImreadFlag(bool color, int decodeScale) {
+    switch (decodeScale) {
+    case 1:
+        return color ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE;
+    case 2:
+        return color ? cv::IMREAD_REDUCED_COLOR_2 : cv::IMREAD_REDUCED_GRAYSCALE_2;
+    case 4:
+        return color ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_GRAYSCALE_4;
+    case 8:
+        return color ? cv::IMREAD_REDUCED_COLOR_8 : cv::IMREAD_REDUCED_GRAYSCALE_8;
+    default:
+        return -1;
+    }
+}
+
+int featureImreadFlag(const std::string& featureType, int decodeScale) {
+    const FeatureComputer* computer = findFeatureComputer(featureType);
+    if (!computer || (decodeScale != 1 && !computer->scalable)) {
+        return -1;
+    }
+    return reducedImreadFlag(computer->needsColor, decodeScale);
+}
+
+bool computeImageFeatures(const std::string& featureType, const cv::Mat& image, std::vector<float>& features) {
+    features.clear();
+    const FeatureComputer* computer = findFeatureComputer(featureType);
+    if (!computer) {
+        std::cerr << "Error: Feature type " << featureType << " cannot be computed from an image" << std::endl;
+        return false;
+    }
+    if (image.empty() || (computer->needsColor && image.channels() != 3)) {
+        return false;
+    }
+
+    ImageContext context(image);
+    return computer->compute(context, features);
+}
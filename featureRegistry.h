@@ -0,0 +1,71 @@
+/**
+
+featureRegistry.h
+Project 2
+
+Registry of the feature families that can be computed from an image, keyed by the
+feature type recorded in their stores. Computers receive an ImageContext instead of
+a file path: the image is decoded once and the greyscale and HSV conversions are
+made on first use and shared by every family that needs them, so one pass over the
+collection can fill every store.
+
+Global histogram families can also be computed from a reduced-resolution decode
+(cv::IMREAD_REDUCED_*_2/4/8), which libjpeg performs in the DCT domain at a fraction
+of the cost of a full decode. The scale is recorded in the store so that query
+images are decoded the same way.
+
+**/
+#ifndef FEATUREREGISTRY_H
+#define FEATUREREGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// A decoded image and the intermediates derived from it
+class ImageContext {
+public:
+    // image is BGR (3 channels) or greyscale (1 channel)
+    explicit ImageContext(const cv::Mat& image);
+
+    const cv::Mat& bgr() const { return bgr_; } // empty for a greyscale image
+    const cv::Mat& gray();
+    const cv::Mat& hsv();                       // empty for a greyscale image
+
+private:
+    cv::Mat bgr_;
+    cv::Mat gray_;
+    cv::Mat hsv_;
+};
+
+struct FeatureComputer {
+    std::string featureType;
+    uint32_t normalization; // FeatureNorm recorded in the store
+    bool needsColor;        // false if the greyscale image is enough
+    bool scalable;          // tolerates a reduced-resolution decode (global histograms)
+    std::string defaultMetric;
+    bool (*compute)(ImageContext& image, std::vector<float>& features);
+};
+
+// Every registered computer; the built-in families are registered on first use
+const std::vector<FeatureComputer>& featureComputers();
+const FeatureComputer* findFeatureComputer(const std::string& featureType);
+
+// Add a family; a computer with the same feature type is replaced. Register before
+// starting an ingest, the registry is read without locking.
+void registerFeatureComputer(const FeatureComputer& computer);
+
+// cv::imread / cv::imdecode flag the given feature type expects at 1/decodeScale resolution,
+// or -1 if it cannot be computed from an image (e.g. "resnet18", whose embeddings come from
+// an external network) or not at that scale
+int featureImreadFlag(const std::string& featureType, int decodeScale = 1);
+
+// IMREAD_COLOR / IMREAD_GRAYSCALE or their REDUCED_2/4/8 variants; -1 for other scales
+int reducedImreadFlag(bool color, int decodeScale);
+
+// Compute the feature vector of the given store feature type from an image decoded
+// with featureImreadFlag(featureType). Returns false for unknown types or empty results.
+bool computeImageFeatures(const std::string& featureType, const cv::Mat& image, std::vector<float>& features);
+
+#endif
@@ -0,0 +1,316 @@
+/**
+
+featureStore.cpp
+Project 2
+
+Implementation of the binary feature store writer, the memory-mapped reader and the
+CSV importer. See featureStore.h for the file layout.
+
+**/
+
+#include "featureStore.h"
+#include "quantizedKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t featureRowBytes(uint32_t dim, uint32_t dtype) {
+    switch (dtype) {
+    case FS_DTYPE_UINT8:
+        return alignUp(dim, sizeof(float)) + sizeof(float);
+    case FS_DTYPE_FLOAT16:
+        return static_cast<size_t>(dim) * sizeof(uint16_t);
+    default:
+        return static_cast<size_t>(dim) * sizeof(float);
+    }
+}
+
+// Pad the output stream with zeros up to the next multiple of alignment
+static void padTo(std::ofstream& file, uint64_t alignment) {
+    static const char zeros[FEATURE_STORE_ALIGN] = {0};
+    uint64_t pos = static_cast<uint64_t>(file.tellp());
+    uint64_t padding = alignUp(pos, alignment) - pos;
+    file.write(zeros, padding);
+}
+
+FeatureStoreWriter::~FeatureStoreWriter() {
+    if (file_.is_open()) {
+        close();
+    }
+}
+
+int FeatureStoreWriter::open(const std::string& path, const std::string& featureType, uint32_t normalization, uint32_t dim,
+                             uint32_t dtype) {
+    if (dtype != FS_DTYPE_FLOAT32 && dtype != FS_DTYPE_UINT8 && dtype != FS_DTYPE_FLOAT16) {
+        std::cerr << "Error: Unknown feature store dtype " << dtype << std::endl;
+        return -1;
+    }
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+        std::cerr << "Error: Unable to create feature store " << path << std::endl;
+        return -1;
+    }
+
+    path_ = path;
+    names_.clear();
+    std::memset(&header_, 0, sizeof(header_));
+    header_.version = FEATURE_STORE_VERSION;
+    header_.dtype = dtype;
+    header_.normalization = normalization;
+    header_.dim = dim;
+    header_.rowStride = alignUp(featureRowBytes(dim, dtype), FEATURE_STORE_ALIGN);
+    header_.dataOffset = alignUp(sizeof(FeatureStoreHeader), FEATURE_STORE_ALIGN);
+    std::strncpy(header_.featureType, featureType.c_str(), sizeof(header_.featureType) - 1);
+
+    // The magic is only written by close(), so a partially written store is never opened
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    padTo(file_, FEATURE_STORE_ALIGN);
+    return 0;
+}
+
+int FeatureStoreWriter::append(const std::string& name, const float* values, size_t n) {
+    if (!file_.is_open()) {
+        return -1;
+    }
+
+    if (header_.dim == 0 && names_.empty()) {
+        header_.dim = static_cast<uint32_t>(n);
+        header_.rowStride = alignUp(featureRowBytes(header_.dim, header_.dtype), FEATURE_STORE_ALIGN);
+    }
+    if (n != header_.dim) {
+        std::cerr << "Warning: " << name << " has " << n << " features, expected " << header_.dim
+                  << "; padding/truncating" << std::endl;
+    }
+
+    // Rows are zero padded to the stride so every row starts on an aligned boundary
+    rowBuffer_.assign(header_.rowStride, 0);
+    size_t copied = std::min<size_t>(n, header_.dim);
+    if (header_.dtype == FS_DTYPE_UINT8) {
+        uint8_t* codes = reinterpret_cast<uint8_t*>(rowBuffer_.data());
+        float scale = quantizeUint8(values, copied, codes);
+        std::memcpy(codes + alignUp(header_.dim, sizeof(float)), &scale, sizeof(scale));
+    } else if (header_.dtype == FS_DTYPE_FLOAT16) {
+        uint16_t* halves = reinterpret_cast<uint16_t*>(rowBuffer_.data());
+        for (size_t j = 0; j < copied; ++j) {
+            halves[j] = floatToHalf(values[j]);
+        }
+    } else {
+        std::memcpy(rowBuffer_.data(), values, copied * sizeof(float));
+    }
+    file_.write(rowBuffer_.data(), rowBuffer_.size());
+    names_.push_back(name);
+
+    return file_.good() ? 0 : -1;
+}
+
+int FeatureStoreWriter::close() {
+    if (!file_.is_open()) {
+        return -1;
+    }
+
+    header_.count = names_.size();
+    header_.namesOffset = header_.dataOffset + header_.count * header_.rowStride;
+
+    // Name table: count+1 offsets into the character block that follows it
+    uint64_t offset = 0;
+    for (const auto& name : names_) {
+        file_.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        offset += name.size();
+    }
+    file_.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    for (const auto& name : names_) {
+        file_.write(name.data(), name.size());
+    }
+
+    std::memcpy(header_.magic, FEATURE_STORE_MAGIC, sizeof(header_.magic));
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+
+    bool ok = file_.good();
+    file_.close();
+    names_.clear();
+    if (!ok) {
+        std::cerr << "Error: Failed writing feature store " << path_ << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+FeatureStore::~FeatureStore() {
+    close();
+}
+
+int FeatureStore::open(const std::string& path) {
+    return openMapped(path, false);
+}
+
+int FeatureStore::openQuantized(const std::string& path) {
+    return openMapped(path, true);
+}
+
+int FeatureStore::openMapped(const std::string& path, bool quantized) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FeatureStoreHeader)) {
+        std::cerr << "Error: Feature store " << path << " is truncated" << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error: Unable to map feature store " << path << std::endl;
+        return -1;
+    }
+
+    base_ = static_cast<const uint8_t*>(mapped);
+    mappedSize_ = st.st_size;
+    header_ = reinterpret_cast<const FeatureStoreHeader*>(base_);
+
+    // Validate the header before trusting any of its offsets
+    bool valid = std::memcmp(header_->magic, FEATURE_STORE_MAGIC, sizeof(header_->magic)) == 0 &&
+                 header_->version == FEATURE_STORE_VERSION &&
+                 header_->dtype <= FS_DTYPE_FLOAT16 &&
+                 header_->dataOffset % FEATURE_STORE_ALIGN == 0 &&
+                 header_->rowStride >= featureRowBytes(header_->dim, header_->dtype) &&
+                 header_->namesOffset == header_->dataOffset + header_->count * header_->rowStride &&
+                 header_->namesOffset + (header_->count + 1) * sizeof(uint64_t) <= mappedSize_;
+    if (valid) {
+        nameOffsets_ = reinterpret_cast<const uint64_t*>(base_ + header_->namesOffset);
+        names_ = reinterpret_cast<const char*>(nameOffsets_ + header_->count + 1);
+        valid = reinterpret_cast<const uint8_t*>(names_) + nameOffsets_[header_->count] <= base_ + mappedSize_;
+    }
+    if (!valid) {
+        std::cerr << "Error: " << path << " is not a valid feature store" << std::endl;
+        close();
+        return -1;
+    }
+    // Float readers cast rows to float*, so the two kinds of store are never opened by the wrong path
+    if ((header_->dtype == FS_DTYPE_FLOAT32) == quantized) {
+        std::cerr << "Error: " << path << (quantized ? " is not a quantized feature store" : " is a quantized feature store, not float32")
+                  << std::endl;
+        close();
+        return -1;
+    }
+
+    data_ = base_ + header_->dataOffset;
+    nameIndex_.build(*this, header_->count);
+    madvise(const_cast<uint8_t*>(base_), mappedSize_, MADV_WILLNEED);
+    return 0;
+}
+
+void FeatureStore::close() {
+    if (base_) {
+        munmap(const_cast<uint8_t*>(base_), mappedSize_);
+    }
+    base_ = nullptr;
+    mappedSize_ = 0;
+    header_ = nullptr;
+    data_ = nullptr;
+    nameOffsets_ = nullptr;
+    names_ = nullptr;
+    nameIndex_.clear();
+}
+
+std::string FeatureStore::featureType() const {
+    if (!header_) {
+        return std::string();
+    }
+    return std::string(header_->featureType, strnlen(header_->featureType, sizeof(header_->featureType)));
+}
+
+int importCsvFeatures(const std::string& csvFile, const std::string& storeFile, const std::string& featureType, uint32_t normalization) {
+    std::ifstream file(csvFile);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open CSV file " << csvFile << std::endl;
+        return -1;
+    }
+
+    FeatureStoreWriter writer;
+    if (writer.open(storeFile, featureType, normalization) != 0) {
+        return -1;
+    }
+
+    std::string line;
+    std::getline(file, line); // Skip header line
+
+    std::vector<float> features;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string filename;
+        std::getline(iss, filename, ',');
+
+        features.clear();
+        std::string feature;
+        while (std::getline(iss, feature, ',')) {
+            features.push_back(std::stof(feature));
+        }
+
+        writer.append(filename, features);
+    }
+
+    return writer.close();
+}
+
+int writeL2NormalizedStore(const FeatureStore& store, const std::string& storeFile) {
+    FeatureStoreWriter writer;
+    if (writer.open(storeFile, store.featureType(), FS_NORM_L2, store.dim()) != 0) {
+        return -1;
+    }
+
+    std::vector<float> normalized(store.dim());
+    for (size_t i = 0; i < store.size(); ++i) {
+        const float* row = store.row(i);
+        float norm2 = 0.0f;
+        for (uint32_t j = 0; j < store.dim(); ++j) {
+            norm2 += row[j] * row[j];
+        }
+        float scale = norm2 > 0.0f ? 1.0f / std::sqrt(norm2) : 0.0f;
+        for (uint32_t j = 0; j < store.dim(); ++j) {
+            normalized[j] = row[j] * scale;
+        }
+        writer.append(std::string(store.name(i)), normalized);
+    }
+
+    return writer.close();
+}
+
+int loadFeatureStore(FeatureStore& store, const std::string& storeFile, const std::string& csvFile, const std::string& featureType, uint32_t normalization) {
+    // A quantized store is refused rather than overwritten by the import below
+    FeatureStoreHeader header;
+    std::ifstream existing(storeFile, std::ios::binary);
+    if (existing.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        std::memcmp(header.magic, FEATURE_STORE_MAGIC, sizeof(header.magic)) == 0 && header.dtype != FS_DTYPE_FLOAT32) {
+        std::cerr << "Error: " << storeFile << " is a quantized feature store, not float32" << std::endl;
+        return -1;
+    }
+    existing.close();
+
+    if (store.open(storeFile) == 0) {
+        return 0;
+    }
+
+    std::cout << "Importing " << csvFile << " into " << storeFile << std::endl;
+    if (importCsvFeatures(csvFile, storeFile, featureType, normalization) != 0) {
+        return -1;
+    }
+    return store.open(storeFile);
+}
@@ -0,0 +1,239 @@
+/**
+
+featureStore.h
+Project 2
+
+Binary feature store shared by the extractors and the matchers. A store is a single
+file holding a fixed-size header (feature type, dimension, dtype, normalization),
+one contiguous 64-byte aligned block of feature vectors and a table of filenames.
+Matchers map the file into memory and scan the vectors in place, so there is no
+parse step between opening the store and answering a query.
+
+File layout (native little-endian):
+  [FeatureStoreHeader, 128 bytes]
+  [count rows of rowStride bytes, starting at dataOffset (64-byte aligned)]
+  [count+1 uint64 name offsets][concatenated filenames], starting at namesOffset
+
+A float32 row is dim floats. A uint8 row is dim codes, padded to a multiple of four,
+followed by the float scale that maps codes back to values (value = code * scale).
+A float16 row is dim IEEE half-precision values. Rows are zero padded to rowStride.
+FeatureStore::open() only accepts float32 stores, so row() always points at floats;
+the quantized dtypes are opened with openQuantized().
+
+**/
+#ifndef FEATURESTORE_H
+#define FEATURESTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define FEATURE_STORE_MAGIC "CBIRFEAT"
+#define FEATURE_STORE_VERSION 1
+#define FEATURE_STORE_ALIGN 64
+
+// Element type of the stored vectors
+enum FeatureDType : uint32_t {
+    FS_DTYPE_FLOAT32 = 0,
+    FS_DTYPE_UINT8 = 1,  // codes with a per-row scale, for non-negative features
+    FS_DTYPE_FLOAT16 = 2
+};
+
+// Bytes of one unpadded row of dim elements
+size_t featureRowBytes(uint32_t dim, uint32_t dtype);
+
+// Normalization that was applied to each vector before it was stored
+enum FeatureNorm : uint32_t {
+    FS_NORM_NONE = 0,
+    FS_NORM_MINMAX = 1,
+    FS_NORM_L2 = 2,
+    FS_NORM_L1 = 3 // values sum to one (histograms)
+};
+
+// Open-addressing hash table from filename to row id. The names stay in their owner's
+// name table; Names is any type with a std::string_view name(size_t) const member.
+class NameIndex {
+public:
+    // Index the first count names of names
+    template <class Names>
+    void build(const Names& names, size_t count) {
+        slots_.assign(tableSize(count), 0);
+        count_ = 0;
+        for (size_t i = 0; i < count; ++i) {
+            insert(names, static_cast<uint32_t>(i));
+        }
+    }
+
+    // Add row id; returns false (and keeps the earlier row) if its name is already indexed
+    template <class Names>
+    bool insert(const Names& names, uint32_t id) {
+        if ((count_ + 1) * 2 > slots_.size()) {
+            std::vector<uint32_t> old(tableSize(count_ + 1), 0);
+            old.swap(slots_);
+            for (uint32_t slot : old) {
+                if (slot != 0) {
+                    slots_[probe(names, names.name(slot - 1))] = slot;
+                }
+            }
+        }
+        size_t s = probe(names, names.name(id));
+        if (slots_[s] != 0) {
+            return false;
+        }
+        slots_[s] = id + 1;
+        ++count_;
+        return true;
+    }
+
+    // Row id of name, or -1
+    template <class Names>
+    long find(const Names& names, std::string_view name) const {
+        if (slots_.empty()) {
+            return -1;
+        }
+        uint32_t slot = slots_[probe(names, name)];
+        return slot != 0 ? static_cast<long>(slot) - 1 : -1;
+    }
+
+    void clear() {
+        slots_.clear();
+        count_ = 0;
+    }
+
+private:
+    // Power of two with at most half of the slots in use
+    static size_t tableSize(size_t count) {
+        size_t size = 16;
+        while (size < 2 * count) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    // Slot holding name, or the empty slot where it would go
+    template <class Names>
+    size_t probe(const Names& names, std::string_view name) const {
+        size_t mask = slots_.size() - 1;
+        size_t s = std::hash<std::string_view>()(name) & mask;
+        while (slots_[s] != 0 && names.name(slots_[s] - 1) != name) {
+            s = (s + 1) & mask;
+        }
+        return s;
+    }
+
+    std::vector<uint32_t> slots_; // row id + 1, 0 for an empty slot
+    size_t count_ = 0;
+};
+
+// On-disk header, exactly 128 bytes
+struct FeatureStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t normalization;
+    uint32_t dim;
+    uint64_t count;
+    uint64_t rowStride;   // bytes between consecutive rows
+    uint64_t dataOffset;  // start of the vector block
+    uint64_t namesOffset; // start of the filename table
+    char featureType[32];
+    uint32_t decodeScale; // images were decoded at 1/decodeScale resolution; 0 (older stores) means 1
+    uint8_t reserved[36];
+};
+static_assert(sizeof(FeatureStoreHeader) == 128, "FeatureStoreHeader must be 128 bytes");
+
+// Streams feature vectors into a store file. Rows are written as they are appended;
+// only the filenames are kept in memory until close() writes the name table and header.
+class FeatureStoreWriter {
+public:
+    FeatureStoreWriter() = default;
+    ~FeatureStoreWriter();
+    FeatureStoreWriter(const FeatureStoreWriter&) = delete;
+    FeatureStoreWriter& operator=(const FeatureStoreWriter&) = delete;
+
+    // dim = 0 takes the dimension from the first appended row. Rows are always appended
+    // as floats and encoded to dtype on the way out.
+    int open(const std::string& path, const std::string& featureType, uint32_t normalization, uint32_t dim = 0,
+             uint32_t dtype = FS_DTYPE_FLOAT32);
+    int append(const std::string& name, const float* values, size_t n);
+    int append(const std::string& name, const std::vector<float>& values) {
+        return append(name, values.data(), values.size());
+    }
+    int close();
+    bool isOpen() const { return file_.is_open(); }
+
+    // Record the reduced-resolution decode the vectors were computed from (call after open)
+    void setDecodeScale(uint32_t scale) { header_.decodeScale = scale; }
+
+private:
+    std::ofstream file_;
+    std::string path_;
+    FeatureStoreHeader header_{};
+    std::vector<std::string> names_;
+    std::vector<char> rowBuffer_;
+};
+
+// Read-only, memory-mapped view of a store file
+class FeatureStore {
+public:
+    FeatureStore() = default;
+    ~FeatureStore();
+    FeatureStore(const FeatureStore&) = delete;
+    FeatureStore& operator=(const FeatureStore&) = delete;
+
+    // Open a float32 store; every row() consumer goes through this
+    int open(const std::string& path);
+    // Open a uint8 or float16 store (see quantizedStore.h); row() must not be used on it
+    int openQuantized(const std::string& path);
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    size_t size() const { return header_ ? header_->count : 0; }
+    uint32_t dim() const { return header_ ? header_->dim : 0; }
+    uint32_t dtype() const { return header_->dtype; }
+    uint32_t normalization() const { return header_->normalization; }
+    size_t rowStride() const { return header_->rowStride; }
+    std::string featureType() const;
+    uint32_t decodeScale() const { return header_->decodeScale > 1 ? header_->decodeScale : 1; }
+
+    const void* rowData(size_t i) const { return data_ + i * header_->rowStride; }
+    const float* row(size_t i) const { return reinterpret_cast<const float*>(rowData(i)); }
+
+    // Rows of FS_DTYPE_UINT8 and FS_DTYPE_FLOAT16 stores
+    const uint8_t* codes(size_t i) const { return static_cast<const uint8_t*>(rowData(i)); }
+    float rowScale(size_t i) const { return *reinterpret_cast<const float*>(codes(i) + ((header_->dim + 3) & ~3u)); }
+    const uint16_t* halfRow(size_t i) const { return static_cast<const uint16_t*>(rowData(i)); }
+    std::string_view name(size_t i) const {
+        return std::string_view(names_ + nameOffsets_[i], nameOffsets_[i + 1] - nameOffsets_[i]);
+    }
+
+    // Returns the row index of the given filename or -1 if it is not in the store.
+    // Filenames are hashed once when the store is opened.
+    long find(std::string_view filename) const { return nameIndex_.find(*this, filename); }
+
+private:
+    const uint8_t* base_ = nullptr;
+    size_t mappedSize_ = 0;
+    const FeatureStoreHeader* header_ = nullptr;
+    const uint8_t* data_ = nullptr;
+    const uint64_t* nameOffsets_ = nullptr;
+    const char* names_ = nullptr;
+    NameIndex nameIndex_;
+
+    int openMapped(const std::string& path, bool quantized);
+};
+
+// Convert a features CSV (filename followed by feature values) into a store file
+int importCsvFeatures(const std::string& csvFile, const std::string& storeFile, const std::string& featureType, uint32_t normalization);
+
+// Write a copy of store with every row scaled to unit L2 norm (zero rows stay zero)
+int writeL2NormalizedStore(const FeatureStore& store, const std::string& storeFile);
+
+// Open storeFile, importing it from csvFile first if the store does not exist yet
+int loadFeatureStore(FeatureStore& store, const std::string& storeFile, const std::string& csvFile, const std::string& featureType, uint32_t normalization);
+
+#endif
@@ -0,0 +1,255 @@
+/**
+
+fusionEngine.cpp
+Project 2
+
+Distance statistics cache and the fused single-pass ranking.
+
+**/
+
+#include "fusionEngine.h"
+#include "distanceKernels.h"
+#include "topK.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <sys/stat.h>
+
+int parseFusionMetric(const std::string& name, FusionMetric& metric) {
+    if (name == "ssd") {
+        metric = FUSION_SSD;
+    } else if (name == "l1") {
+        metric = FUSION_L1;
+    } else if (name == "intersection") {
+        metric = FUSION_INTERSECTION;
+    } else if (name == "cosine") {
+        metric = FUSION_COSINE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Distance between two rows; normA is the L2 norm of a, only used by cosine.
+// Sets valid to false for a zero-length cosine vector.
+static float fusionDistance(FusionMetric metric, const float* a, const float* b, size_t n, float normA, bool& valid) {
+    valid = true;
+    switch (metric) {
+    case FUSION_SSD:
+        return ssdDistance(a, b, n);
+    case FUSION_L1:
+        return l1Distance(a, b, n);
+    case FUSION_INTERSECTION:
+        return 1.0f - histogramIntersection(a, b, n);
+    case FUSION_COSINE: {
+        float angle = cosineDistance(a, b, n, normA);
+        valid = angle >= 0.0f;
+        return angle;
+    }
+    }
+    valid = false;
+    return 0.0f;
+}
+
+// Size and modification time identifying the store file the statistics were sampled from
+static int storeVersion(const std::string& storeFile, uint64_t& bytes, int64_t& mtime) {
+    struct stat st;
+    if (stat(storeFile.c_str(), &st) != 0) {
+        return -1;
+    }
+    bytes = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return 0;
+}
+
+static DistanceStats sampleDistanceStats(const FeatureStore& store, FusionMetric metric) {
+    DistanceStats stats;
+    if (store.size() < 2) {
+        return stats;
+    }
+
+    // Fixed seed, so a rebuilt cache of the same store holds the same numbers
+    std::mt19937_64 rng(1);
+    std::uniform_int_distribution<size_t> pick(0, store.size() - 1);
+    double sum = 0.0, sumSquares = 0.0;
+    for (int s = 0; s < FUSION_STATS_SAMPLES; ++s) {
+        size_t i = pick(rng), j = pick(rng);
+        if (i == j) {
+            continue;
+        }
+        float normA = metric == FUSION_COSINE ? l2Norm(store.row(i), store.dim()) : 0.0f;
+        bool valid;
+        float distance = fusionDistance(metric, store.row(i), store.row(j), store.dim(), normA, valid);
+        if (!valid) {
+            continue;
+        }
+        sum += distance;
+        sumSquares += static_cast<double>(distance) * distance;
+        ++stats.samples;
+    }
+    if (stats.samples > 0) {
+        double mean = sum / stats.samples;
+        double variance = std::max(sumSquares / stats.samples - mean * mean, 0.0);
+        stats.mean = static_cast<float>(mean);
+        stats.stddev = variance > 0.0 ? static_cast<float>(std::sqrt(variance)) : 1.0f;
+    }
+    return stats;
+}
+
+int loadDistanceStats(const FeatureStore& store, const std::string& storeFile, const std::string& metric, DistanceStats& stats) {
+    FusionMetric kind;
+    if (parseFusionMetric(metric, kind) != 0) {
+        std::cerr << "Error: Unknown metric " << metric << std::endl;
+        return -1;
+    }
+    uint64_t bytes = 0;
+    int64_t mtime = 0;
+    if (storeVersion(storeFile, bytes, mtime) != 0) {
+        std::cerr << "Error: Unable to stat feature store " << storeFile << std::endl;
+        return -1;
+    }
+
+    // Lines of other metrics, or of this metric for an older store, are kept or replaced
+    std::string statsFile = storeFile + ".stats";
+    std::vector<std::string> otherLines;
+    std::ifstream in(statsFile);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        std::string lineMetric;
+        uint64_t lineBytes = 0;
+        int64_t lineMtime = 0;
+        DistanceStats cached;
+        char comma1 = 0, comma2 = 0, comma3 = 0, comma4 = 0;
+        if (!std::getline(iss, lineMetric, ',') ||
+            !(iss >> lineBytes >> comma1 >> lineMtime >> comma2 >> cached.samples >> comma3 >> cached.mean >> comma4 >> cached.stddev) ||
+            comma1 != ',' || comma2 != ',' || comma3 != ',' || comma4 != ',') {
+            continue;
+        }
+        if (lineMetric != metric) {
+            otherLines.push_back(line);
+        } else if (lineBytes == bytes && lineMtime == mtime && cached.stddev > 0.0f) {
+            stats = cached;
+            return 0;
+        }
+    }
+    in.close();
+
+    stats = sampleDistanceStats(store, kind);
+
+    std::string tempPath = statsFile + ".tmp";
+    std::ofstream out(tempPath, std::ios::trunc);
+    for (const auto& other : otherLines) {
+        out << other << "\n";
+    }
+    out << metric << "," << bytes << "," << mtime << "," << stats.samples << "," << stats.mean << "," << stats.stddev << "\n";
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), statsFile.c_str()) != 0) {
+        // Only the cache is lost; the statistics themselves are fine
+        std::cerr << "Warning: Unable to write " << statsFile << std::endl;
+        std::remove(tempPath.c_str());
+    }
+    return 0;
+}
+
+int FusionEngine::addFeature(const FeatureStore& store, const std::string& storeFile, const std::string& metric, float weight) {
+    FusionMetric kind;
+    if (parseFusionMetric(metric, kind) != 0) {
+        std::cerr << "Error: Unknown metric " << metric << std::endl;
+        return -1;
+    }
+    Feature feature{&store, metric, kind, weight, DistanceStats(), {}};
+    if (loadDistanceStats(store, storeFile, metric, feature.stats) != 0) {
+        return -1;
+    }
+    features_.push_back(std::move(feature));
+    return 0;
+}
+
+void FusionEngine::build() {
+    joinedIds_.clear();
+    for (auto& feature : features_) {
+        feature.rows.clear();
+    }
+    if (features_.empty()) {
+        return;
+    }
+
+    // The stores hash their filenames when opened, so the join is one lookup per image and store
+    const FeatureStore& first = *features_[0].store;
+    joinedIds_.assign(first.size(), -1);
+    std::vector<uint32_t> rows(features_.size());
+    for (size_t i = 0; i < first.size(); ++i) {
+        std::string_view filename = first.name(i);
+        rows[0] = static_cast<uint32_t>(i);
+        bool everywhere = true;
+        for (size_t f = 1; f < features_.size() && everywhere; ++f) {
+            long row = features_[f].store->find(filename);
+            everywhere = row >= 0;
+            if (everywhere) {
+                rows[f] = static_cast<uint32_t>(row);
+            }
+        }
+        if (!everywhere) {
+            continue;
+        }
+        joinedIds_[i] = static_cast<long>(size());
+        for (size_t f = 0; f < features_.size(); ++f) {
+            features_[f].rows.push_back(rows[f]);
+        }
+    }
+}
+
+long FusionEngine::find(std::string_view filename) const {
+    if (features_.empty()) {
+        return -1;
+    }
+    long row = features_[0].store->find(filename);
+    return row >= 0 && static_cast<size_t>(row) < joinedIds_.size() ? joinedIds_[row] : -1;
+}
+
+std::vector<std::pair<std::string, float>> FusionEngine::query(const std::vector<const float*>& queries, long excludeId, int k) const {
+    std::vector<std::pair<std::string, float>> matches;
+    if (queries.size() != features_.size() || k <= 0) {
+        return matches;
+    }
+
+    // weight * (distance - mean) / stddev is scale * distance - offset
+    size_t featureCount = features_.size();
+    std::vector<float> scale(featureCount), offset(featureCount), queryNorm(featureCount);
+    for (size_t f = 0; f < featureCount; ++f) {
+        const Feature& feature = features_[f];
+        scale[f] = feature.weight / feature.stats.stddev;
+        offset[f] = scale[f] * feature.stats.mean;
+        queryNorm[f] = feature.kind == FUSION_COSINE ? l2Norm(queries[f], feature.store->dim()) : 0.0f;
+    }
+
+    TopK best(static_cast<size_t>(k));
+    for (size_t id = 0; id < size(); ++id) {
+        if (static_cast<long>(id) == excludeId) {
+            continue;
+        }
+        float fused = 0.0f;
+        bool valid = true;
+        for (size_t f = 0; f < featureCount && valid; ++f) {
+            const Feature& feature = features_[f];
+            float distance = fusionDistance(feature.kind, queries[f], feature.store->row(feature.rows[id]), feature.store->dim(),
+                                            queryNorm[f], valid);
+            fused += scale[f] * distance - offset[f];
+        }
+        if (valid) {
+            best.push(static_cast<uint32_t>(id), fused);
+        }
+    }
+
+    for (const auto& match : best.sorted()) {
+        matches.push_back({std::string(name(match.id)), match.score});
+    }
+    return matches;
+}
@@ -0,0 +1,94 @@
+/**
+
+fusionEngine.h
+Project 2
+
+Late fusion of several feature families into one ranking. Each family is a feature
+store (one column of the collection); the engine joins the stores on filename once,
+so image j of the fused collection is a row index into every store, and a query is a
+single pass over the joined ids that scores every family for the image and pushes
+the weighted sum into one top-k.
+
+Raw distances of different families are not comparable (an angle, a sum of squares,
+one minus an intersection), so each is z-normalized with the mean and standard
+deviation of that family's distances between random pairs of the collection before
+weighting. The statistics are sampled once and cached beside the store.
+
+Stats cache (<storeFile>.stats), one line per metric:
+  metric,storeBytes,storeMtimeNanoseconds,samples,mean,stddev
+A line is only used while the store file's size and mtime match.
+
+**/
+#ifndef FUSIONENGINE_H
+#define FUSIONENGINE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "featureStore.h"
+
+// Random pairs sampled for a family's distance statistics
+#define FUSION_STATS_SAMPLES 4096
+
+// Distribution of a family's distances over the collection
+struct DistanceStats {
+    uint64_t samples = 0;
+    float mean = 0.0f;
+    float stddev = 1.0f;
+};
+
+// Metrics a family can be fused under; intersection is used as 1 - intersection and
+// cosine as the angle between the vectors
+enum FusionMetric {
+    FUSION_SSD,
+    FUSION_L1,
+    FUSION_INTERSECTION,
+    FUSION_COSINE
+};
+
+// Parse ssd, l1, intersection or cosine; returns -1 for any other name
+int parseFusionMetric(const std::string& name, FusionMetric& metric);
+
+// Load the statistics of metric over store from <storeFile>.stats, or sample them and
+// rewrite the cache if they are missing or the store has changed. Returns -1 on error.
+int loadDistanceStats(const FeatureStore& store, const std::string& storeFile, const std::string& metric, DistanceStats& stats);
+
+class FusionEngine {
+public:
+    // Add a family. The store must stay open while the engine is used. Returns -1 if
+    // the metric is unknown or the statistics cannot be computed.
+    int addFeature(const FeatureStore& store, const std::string& storeFile, const std::string& metric, float weight);
+
+    // Join the families on filename; only images present in every store are ranked
+    void build();
+
+    size_t size() const { return features_.empty() ? 0 : features_[0].rows.size(); }
+    size_t featureCount() const { return features_.size(); }
+    std::string_view name(size_t id) const { return features_[0].store->name(features_[0].rows[id]); }
+
+    // Joined id of filename, or -1
+    long find(std::string_view filename) const;
+
+    // The k images closest to the query, one vector per family in the order they were
+    // added (each of its store's dimension), best first as (filename, fused distance).
+    // The fused distance is the weighted sum of the z-normalized family distances.
+    // excludeId (-1 for none) is left out, e.g. the query image itself.
+    std::vector<std::pair<std::string, float>> query(const std::vector<const float*>& queries, long excludeId, int k) const;
+
+private:
+    struct Feature {
+        const FeatureStore* store;
+        std::string metric;
+        FusionMetric kind;
+        float weight;
+        DistanceStats stats;
+        std::vector<uint32_t> rows; // store row of every joined id
+    };
+
+    std::vector<Feature> features_;
+    std::vector<long> joinedIds_; // joined id of every row of the first store, -1 if not in every store
+};
+
+#endif
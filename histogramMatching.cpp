@@ -4,122 +4,95 @@ Project 2
   
 Created by Ruohe Zhou and Rucha Pendharkar on 2/8/24
 
-This code is used for Task 2. The code used a whole image RGB histogram using 8 bins 
-for each of RGB and histogram intersection as the distance metric.
+This code is used for Task 2. The code used a whole image rg chromaticity histogram
+(16x16 bins by default) and histogram intersection as the distance metric. The histograms
+of the collection are computed once into features_chroma.bin and reused by every query.
 
 **/
 
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <cstdlib>
+#include <cmath>
 #include <fstream>
 #include <vector>
 #include <algorithm>
 #include <filesystem>
+#include "chromaticity.h"
+#include "featureRegistry.h"
+#include "featureStore.h"
+#include "topK.h"
 
 namespace fs = std::filesystem;
 
-void computeChromaticityHistogram(cv::Mat& image, cv::Mat& histogram) {
-    // Convert the image to RGB color space
-    cv::Mat rgbImage;
-    cv::cvtColor(image, rgbImage, cv::COLOR_BGR2RGB);
-
-    // Split the channels
-    cv::Mat channels[3];
-    cv::split(rgbImage, channels);
-
-    // Assuming red channel for chromaticity
-    cv::Mat chromaticityR = channels[0] / (channels[0] + channels[1] + channels[2]);
-    chromaticityR *= 255;
-
-    // Ensure the image has a single channel
-    if (chromaticityR.channels() != 1) {
-        std::cerr << "Error: Images must be single-channel for chromaticity histogram calculation.\n";
-        return;
-    }
-
-    // Define the number of bins for each channel
-    int bins = 8;
-    int histSize[] = {bins};
-
-    // Set the range for the channel
-    float rRanges[] = {0, 256};
-    const float* ranges[] = {rRanges};
-
-    // Compute the histogram
-    int channelsForHist[] = {0};
-    cv::calcHist(&chromaticityR, 1, channelsForHist, cv::Mat(), histogram, 1, histSize, ranges, true, false);
-}
-
-
-float computeHistogramIntersection(const cv::Mat& hist1, const cv::Mat& hist2) {
-    // Compute the histogram intersection
-    return cv::compareHist(hist1, hist2, cv::HISTCMP_INTERSECT);
-}
-
 std::vector<std::pair<std::string, float>> findMatches(const std::string& targetFilename, const std::string& featureFile, int n) {
     std::vector<std::pair<std::string, float>> distances;
 
-    // Load the target image
-    cv::Mat targetImage = cv::imread(targetFilename);
-    if (targetImage.empty()) {
-        std::cerr << "Error: Unable to read the target image at path " << targetFilename << ".\n";
+    // Map the precomputed chromaticity histograms of the collection
+    FeatureStore store;
+    if (store.open(featureFile) != 0) {
+        std::cerr << "Error: Unable to open the feature store at path " << featureFile << ".\n";
         return distances;
     }
 
-    // Compute the chromaticity histogram for the target image
-    cv::Mat targetHistogram;
-    computeChromaticityHistogram(targetImage, targetHistogram);
-
-    // Load features from the feature file
-    std::ifstream csvFile(featureFile);
-    if (!csvFile.is_open()) {
-        std::cerr << "Error: Unable to open the feature file at path " << featureFile << ".\n";
+    if (!isChromaticityFeatureType(store.featureType(), store.dim())) {
+        std::cerr << "Error: Feature store " << featureFile << " does not hold chromaticity histograms.\n";
         return distances;
     }
-
-    std::string line;
-    std::getline(csvFile, line); // Skip header
-
-    while (std::getline(csvFile, line)) {
-        std::istringstream iss(line);
-        std::string filename;
-        std::getline(iss, filename, ',');
-
-        // Update the path to the images in the ../olympus folder
-        std::string imagePath = "../olympus/" + filename;
-
-        if (imagePath == targetFilename) {
-            continue; // Skip the target image itself
+    int bins = static_cast<int>(std::lround(std::sqrt(static_cast<double>(store.dim()))));
+
+    // A target from the collection uses its stored histogram; any other image is decoded
+    // at the resolution the stored histograms were computed from
+    std::string targetName = fs::path(targetFilename).filename().string();
+    long targetIndex = store.find(targetName);
+    std::vector<float> targetHistogram;
+    if (targetIndex >= 0) {
+        targetHistogram.assign(store.row(targetIndex), store.row(targetIndex) + store.dim());
+    } else {
+        cv::Mat targetImage = cv::imread(targetFilename, reducedImreadFlag(true, static_cast<int>(store.decodeScale())));
+        if (targetImage.empty()) {
+            std::cerr << "Error: Unable to read the target image at path " << targetFilename << ".\n";
+            return distances;
         }
+        computeChromaticityHistogram(targetImage, targetHistogram, bins);
+    }
 
-        // Load the image
-        cv::Mat image = cv::imread(imagePath);
-        if (image.empty()) {
-            std::cerr << "Error: Unable to read the image at path " << imagePath << ".\n";
-            continue;
+    // Keep the n smallest distances while scanning, in ascending order
+    TopK bestMatches(std::max(n, 0));
+    for (size_t i = 0; i < store.size(); ++i) {
+        if (static_cast<long>(i) == targetIndex) {
+            continue; // Skip the target image itself
         }
 
-        // Compute the chromaticity histogram for the current image
-        cv::Mat currentHistogram;
-        computeChromaticityHistogram(image, currentHistogram);
-
-        // Compute the histogram intersection distance
-        float distance = computeHistogramIntersection(targetHistogram, currentHistogram);
-        distances.push_back({filename, distance});
+        // The histograms sum to one, so 1 - intersection is a distance in [0, 1]
+        float distance = 1.0f - computeHistogramIntersection(targetHistogram.data(), store.row(i), store.dim());
+        bestMatches.push(static_cast<uint32_t>(i), distance);
     }
 
-    // Sort in ascending order based on distances
-    std::sort(distances.begin(), distances.end(), [](const auto& a, const auto& b) {
-        return a.second < b.second;
-    });
-
-    return {distances.begin(), distances.begin() + n};
+    // Resolve filenames for the final matches only
+    for (const auto& match : bestMatches.sorted()) {
+        distances.push_back({std::string(store.name(match.id)), match.score});
+    }
+    return distances;
 }
 
-int main() {
-    std::string featureFile = "../features.csv";
-    std::string targetFilename = "../olympus/pic.0164.jpg";
-    int numMatches = 3;
+int main(int argc, char* argv[]) {
+    std::string imageDirectory = "../olympus";
+    std::string featureFile = "../features_chroma.bin";
+
+    // Optional arguments: target image path and number of matches
+    std::string targetFilename = argc > 1 ? argv[1] : "../olympus/pic.0164.jpg";
+    int numMatches = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    // Histogram the collection once; later queries only read the store
+    FeatureStore existing;
+    if (existing.open(featureFile) != 0 || !isChromaticityFeatureType(existing.featureType(), existing.dim())) {
+        existing.close();
+        std::cout << "Computing chromaticity histograms for " << imageDirectory << "\n";
+        if (extractChromaticityFeaturesAndSave(imageDirectory, featureFile) != 0) {
+            return 1;
+        }
+    }
 
     auto matches = findMatches(targetFilename, featureFile, numMatches);
 
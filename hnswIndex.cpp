@@ -0,0 +1,338 @@
+/**
+
+hnswIndex.cpp
+Project 2
+
+Implementation of the HNSW graph index over the ResNet18 embeddings.
+
+**/
+
+#include "hnswIndex.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+
+#define HNSW_MAGIC "CBIRHNSW"
+
+HnswIndex::HnswIndex(uint32_t dim, const HnswParams& params, uint32_t seed)
+    : dim_(dim), params_(params), rng_(seed) {
+    params_.M = std::max(2, params_.M);
+    levelScale_ = 1.0 / std::log(static_cast<double>(params_.M));
+}
+
+float HnswIndex::distance(const float* query, uint32_t id) const {
+    return 1.0f - dotProduct(query, vector(id), dim_);
+}
+
+uint32_t HnswIndex::insert(const float* values, const std::string& name) {
+    uint32_t id = static_cast<uint32_t>(levels_.size());
+    vectors_.insert(vectors_.end(), values, values + dim_);
+    names_.push_back(name);
+
+    // Exponentially decaying level distribution, P(level >= l) = M^-l
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    int level = static_cast<int>(std::floor(-std::log(1.0 - uniform(rng_)) * levelScale_));
+    levels_.push_back(level);
+    links_.emplace_back(level + 1);
+
+    if (maxLevel_ < 0) {
+        entryPoint_ = id;
+        maxLevel_ = level;
+        return id;
+    }
+
+    const float* query = vector(id);
+    uint32_t current = entryPoint_;
+    for (int l = maxLevel_; l > level; --l) {
+        current = greedyClosest(query, current, l);
+    }
+
+    std::vector<Candidate> entries(1, Candidate(distance(query, current), current));
+    for (int l = std::min(level, maxLevel_); l >= 0; --l) {
+        std::vector<Candidate> found = searchLayer(query, entries, params_.efConstruction, l);
+        links_[id][l] = selectNeighbors(found, params_.M);
+
+        // Links are bidirectional; neighbours that overflow are pruned back to the limit
+        for (uint32_t neighbor : links_[id][l]) {
+            links_[neighbor][l].push_back(id);
+            if (static_cast<int>(links_[neighbor][l].size()) > maxLinks(l)) {
+                shrinkLinks(neighbor, l);
+            }
+        }
+        entries.swap(found);
+    }
+
+    if (level > maxLevel_) {
+        maxLevel_ = level;
+        entryPoint_ = id;
+    }
+    return id;
+}
+
+uint32_t HnswIndex::greedyClosest(const float* query, uint32_t entry, int level) const {
+    float best = distance(query, entry);
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (uint32_t neighbor : links_[entry][level]) {
+            float d = distance(query, neighbor);
+            if (d < best) {
+                best = d;
+                entry = neighbor;
+                improved = true;
+            }
+        }
+    }
+    return entry;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::searchLayer(const float* query, const std::vector<Candidate>& entries, int ef, int level) const {
+    // Visited marks are stamped with a per-search epoch so the buffer is never cleared
+    thread_local std::vector<uint32_t> visited;
+    thread_local uint32_t epoch = 0;
+    if (visited.size() < levels_.size()) {
+        visited.resize(levels_.size(), 0);
+    }
+    if (++epoch == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        epoch = 1;
+    }
+
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates; // nearest on top
+    std::priority_queue<Candidate> results;                                                    // farthest on top
+    for (const auto& entry : entries) {
+        visited[entry.second] = epoch;
+        candidates.push(entry);
+        results.push(entry);
+    }
+    while (static_cast<int>(results.size()) > ef) {
+        results.pop();
+    }
+
+    while (!candidates.empty()) {
+        Candidate nearest = candidates.top();
+        if (nearest.first > results.top().first && static_cast<int>(results.size()) >= ef) {
+            break;
+        }
+        candidates.pop();
+
+        for (uint32_t neighbor : links_[nearest.second][level]) {
+            if (visited[neighbor] == epoch) {
+                continue;
+            }
+            visited[neighbor] = epoch;
+
+            float d = distance(query, neighbor);
+            if (static_cast<int>(results.size()) < ef || d < results.top().first) {
+                candidates.push(Candidate(d, neighbor));
+                results.push(Candidate(d, neighbor));
+                if (static_cast<int>(results.size()) > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Candidate> found;
+    found.reserve(results.size());
+    while (!results.empty()) {
+        found.push_back(results.top());
+        results.pop();
+    }
+    std::reverse(found.begin(), found.end());
+    return found;
+}
+
+std::vector<uint32_t> HnswIndex::selectNeighbors(std::vector<Candidate> candidates, int maxCount) const {
+    std::sort(candidates.begin(), candidates.end());
+
+    // Keep a candidate only if it is closer to the base than to every neighbour already
+    // kept, which spreads the links over different directions; pruned candidates fill
+    // any slots that remain so sparse regions still get maxCount links
+    std::vector<uint32_t> selected;
+    std::vector<uint32_t> pruned;
+    for (const auto& candidate : candidates) {
+        if (static_cast<int>(selected.size()) >= maxCount) {
+            break;
+        }
+        bool diverse = true;
+        for (uint32_t kept : selected) {
+            if (distance(vector(candidate.second), kept) < candidate.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) {
+            selected.push_back(candidate.second);
+        } else {
+            pruned.push_back(candidate.second);
+        }
+    }
+    for (size_t i = 0; i < pruned.size() && static_cast<int>(selected.size()) < maxCount; ++i) {
+        selected.push_back(pruned[i]);
+    }
+    return selected;
+}
+
+void HnswIndex::shrinkLinks(uint32_t id, int level) {
+    std::vector<Candidate> candidates;
+    candidates.reserve(links_[id][level].size());
+    for (uint32_t neighbor : links_[id][level]) {
+        candidates.push_back(Candidate(distance(vector(id), neighbor), neighbor));
+    }
+    links_[id][level] = selectNeighbors(candidates, maxLinks(level));
+}
+
+void HnswIndex::search(const float* query, TopK& result, long excludeId) const {
+    if (levels_.empty()) {
+        return;
+    }
+
+    uint32_t current = entryPoint_;
+    for (int l = maxLevel_; l > 0; --l) {
+        current = greedyClosest(query, current, l);
+    }
+
+    // One extra slot so the excluded row does not cost a result
+    int ef = std::max(params_.efSearch, static_cast<int>(result.k()) + 1);
+    std::vector<Candidate> entries(1, Candidate(distance(query, current), current));
+    for (const auto& candidate : searchLayer(query, entries, ef, 0)) {
+        if (static_cast<long>(candidate.second) != excludeId) {
+            result.push(candidate.second, 1.0f - candidate.first);
+        }
+    }
+}
+
+int HnswIndex::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write HNSW index " << path << std::endl;
+        return -1;
+    }
+
+    uint64_t count = levels_.size();
+    file.write(HNSW_MAGIC, 8);
+    file.write(reinterpret_cast<const char*>(&dim_), sizeof(dim_));
+    file.write(reinterpret_cast<const char*>(&params_), sizeof(params_));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(&maxLevel_), sizeof(maxLevel_));
+    file.write(reinterpret_cast<const char*>(&entryPoint_), sizeof(entryPoint_));
+    file.write(reinterpret_cast<const char*>(vectors_.data()), vectors_.size() * sizeof(float));
+
+    for (uint64_t id = 0; id < count; ++id) {
+        uint32_t nameLength = static_cast<uint32_t>(names_[id].size());
+        file.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+        file.write(names_[id].data(), nameLength);
+        file.write(reinterpret_cast<const char*>(&levels_[id]), sizeof(int));
+        for (const auto& links : links_[id]) {
+            uint32_t linkCount = static_cast<uint32_t>(links.size());
+            file.write(reinterpret_cast<const char*>(&linkCount), sizeof(linkCount));
+            file.write(reinterpret_cast<const char*>(links.data()), links.size() * sizeof(uint32_t));
+        }
+    }
+    return file.good() ? 0 : -1;
+}
+
+int HnswIndex::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return -1;
+    }
+    uint64_t fileBytes = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    // Bytes left after the read position; every size taken from the file is bounded by it before allocating
+    auto remaining = [&]() -> uint64_t { return file ? fileBytes - static_cast<uint64_t>(file.tellg()) : 0; };
+
+    char magic[8];
+    uint64_t count = 0;
+    file.read(magic, 8);
+    file.read(reinterpret_cast<char*>(&dim_), sizeof(dim_));
+    file.read(reinterpret_cast<char*>(&params_), sizeof(params_));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    file.read(reinterpret_cast<char*>(&maxLevel_), sizeof(maxLevel_));
+    file.read(reinterpret_cast<char*>(&entryPoint_), sizeof(entryPoint_));
+    if (!file || std::memcmp(magic, HNSW_MAGIC, 8) != 0 || params_.M < 2) {
+        std::cerr << "Error: " << path << " is not an HNSW index" << std::endl;
+        return -1;
+    }
+
+    // Each row holds its vector, a name length, a level and at least one link count
+    uint64_t minRowBytes = static_cast<uint64_t>(dim_) * sizeof(float) + 3 * sizeof(uint32_t);
+    bool valid = count <= remaining() / minRowBytes;
+    if (valid) {
+        vectors_.resize(count * dim_);
+        names_.resize(count);
+        levels_.resize(count);
+        links_.assign(count, std::vector<std::vector<uint32_t>>());
+        file.read(reinterpret_cast<char*>(vectors_.data()), vectors_.size() * sizeof(float));
+    }
+
+    // A corrupt level or link count would misalign every later record, so either fails the load
+    for (uint64_t id = 0; id < count && file && valid; ++id) {
+        uint32_t nameLength = 0;
+        file.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
+        if (nameLength > remaining()) {
+            valid = false;
+            break;
+        }
+        names_[id].resize(nameLength);
+        file.read(&names_[id][0], nameLength);
+        file.read(reinterpret_cast<char*>(&levels_[id]), sizeof(int));
+        if (levels_[id] < 0 || levels_[id] > maxLevel_ || static_cast<uint64_t>(levels_[id]) >= remaining() / sizeof(uint32_t)) {
+            valid = false;
+            break;
+        }
+        links_[id].resize(levels_[id] + 1);
+        for (auto& links : links_[id]) {
+            uint32_t linkCount = 0;
+            file.read(reinterpret_cast<char*>(&linkCount), sizeof(linkCount));
+            if (linkCount > static_cast<uint32_t>(2 * params_.M) || linkCount > remaining() / sizeof(uint32_t)) {
+                valid = false;
+                break;
+            }
+            links.resize(linkCount);
+            file.read(reinterpret_cast<char*>(links.data()), links.size() * sizeof(uint32_t));
+            for (uint32_t link : links) {
+                valid = valid && link < count;
+            }
+        }
+    }
+    if (!file || !valid || (count > 0 && (entryPoint_ >= count || levels_[entryPoint_] != maxLevel_))) {
+        std::cerr << "Error: HNSW index " << path << " is truncated or corrupt" << std::endl;
+        levels_.clear();
+        links_.clear();
+        vectors_.clear();
+        names_.clear();
+        maxLevel_ = -1;
+        return -1;
+    }
+
+    // Continue the level sequence deterministically when more rows are inserted later
+    levelScale_ = 1.0 / std::log(static_cast<double>(params_.M));
+    rng_.seed(static_cast<uint32_t>(100 + count));
+    return 0;
+}
+
+long insertStoreRows(HnswIndex& index, const FeatureStore& store) {
+    if (index.dim() != store.dim() || index.size() > store.size()) {
+        return -1;
+    }
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (store.name(i) != index.name(static_cast<uint32_t>(i))) {
+            return -1;
+        }
+    }
+
+    long inserted = 0;
+    for (size_t i = index.size(); i < store.size(); ++i) {
+        index.insert(store.row(i), std::string(store.name(i)));
+        ++inserted;
+    }
+    return inserted;
+}
@@ -0,0 +1,77 @@
+/**
+
+hnswIndex.h
+Project 2
+
+Hierarchical Navigable Small World graph index for cosine search over the ResNet18
+embeddings. Vectors are inserted one at a time into a layered proximity graph; a
+query descends greedily through the sparse upper layers and runs a best-first
+search of width efSearch on the bottom layer, so query cost grows roughly with the
+logarithm of the collection size. Vectors are expected to be L2-normalized and the
+graph distance is 1 - dot product.
+
+**/
+#ifndef HNSWINDEX_H
+#define HNSWINDEX_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "featureStore.h"
+#include "topK.h"
+
+struct HnswParams {
+    int M = 16;               // links per node on the upper layers, 2*M on layer 0
+    int efConstruction = 200; // candidate list width while inserting
+    int efSearch = 64;        // candidate list width while querying
+};
+
+class HnswIndex {
+public:
+    explicit HnswIndex(uint32_t dim = 0, const HnswParams& params = HnswParams(), uint32_t seed = 100);
+
+    // Add one vector; ids are assigned in insertion order starting at 0
+    uint32_t insert(const float* vector, const std::string& name = std::string());
+
+    // Top-k by cosine similarity (larger is better); excludeId is skipped, -1 skips nothing
+    void search(const float* query, TopK& result, long excludeId = -1) const;
+
+    void setEfSearch(int efSearch) { params_.efSearch = efSearch; }
+    const HnswParams& params() const { return params_; }
+    size_t size() const { return levels_.size(); }
+    uint32_t dim() const { return dim_; }
+    const std::string& name(uint32_t id) const { return names_[id]; }
+
+    int save(const std::string& path) const;
+    int load(const std::string& path);
+
+private:
+    typedef std::pair<float, uint32_t> Candidate; // (distance, id)
+
+    const float* vector(uint32_t id) const { return &vectors_[static_cast<size_t>(id) * dim_]; }
+    float distance(const float* query, uint32_t id) const;
+    int maxLinks(int level) const { return level == 0 ? 2 * params_.M : params_.M; }
+    uint32_t greedyClosest(const float* query, uint32_t entry, int level) const;
+    std::vector<Candidate> searchLayer(const float* query, const std::vector<Candidate>& entries, int ef, int level) const;
+    std::vector<uint32_t> selectNeighbors(std::vector<Candidate> candidates, int maxCount) const;
+    void shrinkLinks(uint32_t id, int level);
+
+    uint32_t dim_;
+    HnswParams params_;
+    double levelScale_;
+    std::mt19937 rng_;
+    int maxLevel_ = -1;
+    uint32_t entryPoint_ = 0;
+    std::vector<float> vectors_;
+    std::vector<std::string> names_;
+    std::vector<int> levels_;
+    std::vector<std::vector<std::vector<uint32_t>>> links_; // links_[id][level]
+};
+
+// Insert every row of an L2-normalized store that the index does not hold yet.
+// Returns the number of rows inserted, or -1 if the index was built from a different store.
+long insertStoreRows(HnswIndex& index, const FeatureStore& store);
+
+#endif
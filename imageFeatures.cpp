@@ -0,0 +1,238 @@
+/**
+
+imageFeatures.cpp
+Project 2
+
+Implementation of the shared feature computations.
+
+**/
+
+#include "imageFeatures.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+void computeOrbCenterFeatures(const cv::Mat& grey, std::vector<float>& features) {
+    cv::Ptr<cv::ORB> orb = cv::ORB::create();
+
+    // Compute the center region
+    int regionSize = 7;
+    int startX = grey.cols / 2 - regionSize / 2;
+    int startY = grey.rows / 2 - regionSize / 2;
+
+    // Clamp start coordinates to ensure region is within the image bounds
+    startX = std::max(0, startX);
+    startY = std::max(0, startY);
+    int endX = std::min(grey.cols, startX + regionSize);
+    int endY = std::min(grey.rows, startY + regionSize);
+
+    // Crop the center region
+    cv::Mat centerRegion = grey(cv::Rect(startX, startY, endX - startX, endY - startY));
+
+    // Detect keypoints
+    std::vector<cv::KeyPoint> keypoints;
+    orb->detect(centerRegion, keypoints);
+
+    cv::Mat descriptors;
+    orb->compute(centerRegion, keypoints, descriptors);
+
+    // Convert descriptors to float vector
+    features.clear();
+    features.reserve(descriptors.rows * descriptors.cols);
+    for (int i = 0; i < descriptors.rows; ++i) {
+        for (int j = 0; j < descriptors.cols; ++j) {
+            features.push_back(static_cast<float>(descriptors.at<uchar>(i, j)));
+        }
+    }
+}
+
+void computeColorHistogram(const cv::Mat& image, std::vector<float>& histogram) {
+    // Convert image to HSV color space
+    cv::Mat hsvImage;
+    cv::cvtColor(image, hsvImage, cv::COLOR_BGR2HSV);
+    computeColorHistogramFromHsv(hsvImage, histogram);
+}
+
+void computeColorHistogramFromHsv(const cv::Mat& hsvImage, std::vector<float>& histogram) {
+    // Split the channels
+    std::vector<cv::Mat> channels;
+    cv::split(hsvImage, channels);
+
+    // Compute histogram
+    int histSize[] = {256};
+    float range[] = {0, 256};
+    const float* histRange[] = {range};
+
+    for (int i = 0; i < 3; ++i) {
+        cv::Mat channel8U;
+        channels[i].convertTo(channel8U, CV_8U);
+
+        // Calculate histogram for each channel and accumulate values
+        cv::Mat hist;
+        cv::calcHist(&channel8U, 1, nullptr, cv::Mat(), hist, 1, histSize, histRange);
+        histogram.insert(histogram.end(), hist.begin<float>(), hist.end<float>());
+    }
+
+    // Normalize histogram
+    cv::normalize(histogram, histogram, 0, 1, cv::NORM_MINMAX);
+}
+
+void computeTextureHistogram(const cv::Mat& image, std::vector<float>& histogram) {
+    // Convert image to grayscale
+    cv::Mat grayImage;
+    cv::cvtColor(image, grayImage, cv::COLOR_BGR2GRAY);
+    computeTextureHistogramFromGray(grayImage, histogram);
+}
+
+void computeTextureHistogramFromGray(const cv::Mat& grayImage, std::vector<float>& histogram) {
+    // Compute gradients using Sobel operator
+    cv::Mat gradX, gradY;
+    cv::Sobel(grayImage, gradX, CV_32F, 1, 0);
+    cv::Sobel(grayImage, gradY, CV_32F, 0, 1);
+
+    // Compute gradient magnitude
+    cv::Mat magImage;
+    cv::magnitude(gradX, gradY, magImage);
+
+    // Convert gradient magnitude to CV_8U for histogram calculation
+    cv::Mat magImage8U;
+    magImage.convertTo(magImage8U, CV_8U);
+
+    // Compute histogram of gradient magnitudes
+    int histSize = 256;
+    float range[] = {0, 256};
+    const float* histRange[] = {range};
+    cv::calcHist(&magImage8U, 1, 0, cv::Mat(), histogram, 1, &histSize, histRange);
+    cv::normalize(histogram, histogram, 0, 1, cv::NORM_MINMAX);
+}
+
+// Rows converted per cvtColor call; a strip of a 640-pixel-wide image stays in L1/L2
+static const int STRIP_ROWS = 16;
+
+// Sobel magnitude (3x3, as cv::Sobel + cv::magnitude + convertTo(CV_8U)) of one row.
+// top, mid and bottom are grey rows padded with one reflected pixel on each side.
+static void sobelMagnitudeRowScalar(const uchar* top, const uchar* mid, const uchar* bottom, uchar* magnitude, int cols) {
+    for (int x = 0; x < cols; ++x) {
+        int gx = (top[x + 2] + 2 * mid[x + 2] + bottom[x + 2]) - (top[x] + 2 * mid[x] + bottom[x]);
+        int gy = (bottom[x] + 2 * bottom[x + 1] + bottom[x + 2]) - (top[x] + 2 * top[x + 1] + top[x + 2]);
+        long rounded = std::lrint(std::sqrt(static_cast<float>(gx * gx + gy * gy)));
+        magnitude[x] = static_cast<uchar>(std::min(rounded, 255L));
+    }
+}
+
+#ifdef CBIR_X86_SIMD
+// 16 grey pixels widened to 16-bit lanes
+CBIR_TARGET_AVX2 static inline __m256i loadWidened(const uchar* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+CBIR_TARGET_AVX2 static void sobelMagnitudeRowAvx2(const uchar* top, const uchar* mid, const uchar* bottom, uchar* magnitude, int cols) {
+    int x = 0;
+    for (; x + 16 <= cols; x += 16) {
+        __m256i t0 = loadWidened(top + x), t1 = loadWidened(top + x + 1), t2 = loadWidened(top + x + 2);
+        __m256i m0 = loadWidened(mid + x), m2 = loadWidened(mid + x + 2);
+        __m256i b0 = loadWidened(bottom + x), b1 = loadWidened(bottom + x + 1), b2 = loadWidened(bottom + x + 2);
+
+        // |gx|, |gy| <= 1020, so both fit in 16 bits
+        __m256i gx = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(t2, b2), _mm256_slli_epi16(m2, 1)),
+                                      _mm256_add_epi16(_mm256_add_epi16(t0, b0), _mm256_slli_epi16(m0, 1)));
+        __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(b0, b2), _mm256_slli_epi16(b1, 1)),
+                                      _mm256_add_epi16(_mm256_add_epi16(t0, t2), _mm256_slli_epi16(t1, 1)));
+
+        // gx*gx + gy*gy of interleaved (gx, gy) pairs; exact in float, then sqrt and round to nearest even
+        __m256i lo = _mm256_unpacklo_epi16(gx, gy), hi = _mm256_unpackhi_epi16(gx, gy);
+        __m256i magLo = _mm256_cvtps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(lo, lo))));
+        __m256i magHi = _mm256_cvtps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(hi, hi))));
+
+        // Packing undoes the per-lane interleave; packus saturates to 255 like convertTo
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(magLo, magHi), _mm256_setzero_si256());
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(magnitude + x), _mm256_castsi256_si128(packed));
+    }
+    sobelMagnitudeRowScalar(top + x, mid + x, bottom + x, magnitude + x, cols - x);
+}
+#endif
+
+typedef void (*SobelMagnitudeRow)(const uchar*, const uchar*, const uchar*, uchar*, int);
+
+static SobelMagnitudeRow sobelMagnitudeRow() {
+    static const SobelMagnitudeRow row = [] {
+#ifdef CBIR_X86_SIMD
+        if (detectSimdLevel() >= SIMD_AVX2) {
+            return sobelMagnitudeRowAvx2;
+        }
+#endif
+        return sobelMagnitudeRowScalar;
+    }();
+    return row;
+}
+
+void computeColorTextureHistograms(const cv::Mat& image, std::vector<float>& colorHistogram, std::vector<float>& textureHistogram) {
+    if (image.empty() || image.type() != CV_8UC3) {
+        computeColorHistogram(image, colorHistogram);
+        computeTextureHistogram(image, textureHistogram);
+        return;
+    }
+
+    int rows = image.rows, cols = image.cols;
+    int stripRows = std::min(STRIP_ROWS, rows);
+    cv::Mat hsvStrip(stripRows, cols, CV_8UC3), grayStrip(stripRows, cols, CV_8UC1);
+
+    // H, S and V counts back to back, then the magnitude counts
+    uint32_t colorCounts[3 * 256] = {};
+    uint32_t textureCounts[256] = {};
+
+    // Padded grey rows y-2..y, slot y % 3; column 0 and cols+1 hold the BORDER_REFLECT_101 pixels
+    std::vector<uchar> window(3 * static_cast<size_t>(cols + 2));
+    std::vector<uchar> magnitude(cols);
+    auto windowRow = [&](int y) { return window.data() + static_cast<size_t>(y % 3) * (cols + 2); };
+    SobelMagnitudeRow magnitudeRow = sobelMagnitudeRow();
+
+    auto accumulateMagnitude = [&](int y) {
+        int above = y > 0 ? y - 1 : std::min(1, rows - 1);
+        int below = y < rows - 1 ? y + 1 : std::max(rows - 2, 0);
+        magnitudeRow(windowRow(above), windowRow(y), windowRow(below), magnitude.data(), cols);
+        for (int x = 0; x < cols; ++x) {
+            ++textureCounts[magnitude[x]];
+        }
+    };
+
+    for (int y0 = 0; y0 < rows; y0 += stripRows) {
+        int n = std::min(stripRows, rows - y0);
+        cv::Mat bgr = image.rowRange(y0, y0 + n);
+        cv::Mat hsv = hsvStrip.rowRange(0, n), gray = grayStrip.rowRange(0, n);
+        cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+        cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+
+        for (int i = 0; i < n; ++i) {
+            const uchar* pixel = hsv.ptr<uchar>(i);
+            for (int x = 0; x < cols; ++x, pixel += 3) {
+                ++colorCounts[pixel[0]];
+                ++colorCounts[256 + pixel[1]];
+                ++colorCounts[512 + pixel[2]];
+            }
+
+            int y = y0 + i;
+            const uchar* grayRow = gray.ptr<uchar>(i);
+            uchar* padded = windowRow(y);
+            std::memcpy(padded + 1, grayRow, cols);
+            padded[0] = grayRow[cols > 1 ? 1 : 0];
+            padded[cols + 1] = grayRow[cols > 1 ? cols - 2 : 0];
+
+            // Row y-1 has both neighbours once row y is in the window
+            if (y > 0) {
+                accumulateMagnitude(y - 1);
+            }
+        }
+    }
+    accumulateMagnitude(rows - 1);
+
+    // Same normalization as the calcHist based functions
+    colorHistogram.insert(colorHistogram.end(), std::begin(colorCounts), std::end(colorCounts));
+    cv::normalize(colorHistogram, colorHistogram, 0, 1, cv::NORM_MINMAX);
+    textureHistogram.assign(std::begin(textureCounts), std::end(textureCounts));
+    cv::normalize(textureHistogram, textureHistogram, 0, 1, cv::NORM_MINMAX);
+}
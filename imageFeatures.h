@@ -0,0 +1,36 @@
+/**
+
+imageFeatures.h
+Project 2
+
+Feature computations shared by the extractors and the retrieval daemon. Each
+function takes an already decoded image, so the same code produces the stored
+vectors at ingest and the query vector for an image that is not in a store. The
+...FromHsv / ...FromGray variants take intermediates that featureRegistry shares
+between feature families.
+
+**/
+#ifndef IMAGEFEATURES_H
+#define IMAGEFEATURES_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Task 1: ORB descriptors of the 7x7 center region of a greyscale image ("orb-center")
+void computeOrbCenterFeatures(const cv::Mat& grey, std::vector<float>& features);
+
+// Task 4: 3x256 HSV channel histogram, appended to histogram and min-max normalized
+void computeColorHistogram(const cv::Mat& image, std::vector<float>& histogram);
+void computeColorHistogramFromHsv(const cv::Mat& hsvImage, std::vector<float>& histogram);
+
+// Task 4: 256-bin histogram of the Sobel gradient magnitude, min-max normalized
+void computeTextureHistogram(const cv::Mat& image, std::vector<float>& histogram);
+void computeTextureHistogramFromGray(const cv::Mat& grayImage, std::vector<float>& histogram);
+
+// Task 4 in one pass ("hsv-sobel"): the same color and texture histograms as above, but the
+// image is converted to HSV and grey a strip of rows at a time and the Sobel magnitude is
+// computed on a rolling three-row window, so no full-size intermediate image is allocated
+void computeColorTextureHistograms(const cv::Mat& image, std::vector<float>& colorHistogram, std::vector<float>& textureHistogram);
+
+#endif
@@ -0,0 +1,270 @@
+/**
+
+ingestManifest.cpp
+Project 2
+
+Implementation of the ingest manifest and the incremental store ingest.
+
+**/
+
+#include "ingestManifest.h"
+#include "featureStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+int loadIngestManifest(const std::string& path, IngestManifest& manifest) {
+    manifest.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return -1;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        ManifestEntry entry;
+        std::string filename;
+        char comma1 = 0, comma2 = 0, comma3 = 0;
+        iss >> entry.size >> comma1 >> entry.mtime >> comma2 >> std::hex >> entry.hash >> comma3;
+        if (!iss || comma1 != ',' || comma2 != ',' || comma3 != ',' || !std::getline(iss, filename) || filename.empty()) {
+            std::cerr << "Warning: Ignoring malformed manifest line in " << path << std::endl;
+            continue;
+        }
+        manifest[filename] = entry;
+    }
+    return 0;
+}
+
+int saveIngestManifest(const std::string& path, const IngestManifest& manifest) {
+    // Sorted so that manifests of the same directory compare equal
+    std::map<std::string, ManifestEntry> sorted(manifest.begin(), manifest.end());
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write manifest " << path << std::endl;
+        return -1;
+    }
+    for (const auto& item : sorted) {
+        file << item.second.size << "," << item.second.mtime << "," << std::hex << item.second.hash << std::dec << ","
+             << item.first << "\n";
+    }
+    file.close();
+    if (!file || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Unable to write manifest " << path << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+int hashFileContents(const fs::path& path, uint64_t& hash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return -1;
+    }
+
+    hash = FNV1A_OFFSET_BASIS;
+    char buffer[65536];
+    while (file) {
+        file.read(buffer, sizeof(buffer));
+        hash = hashBytes(buffer, static_cast<size_t>(file.gcount()), hash);
+    }
+    return file.bad() ? -1 : 0;
+}
+
+static int statFile(const fs::path& path, ManifestEntry& entry) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    entry.size = static_cast<uint64_t>(st.st_size);
+    entry.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return 0;
+}
+
+namespace {
+
+// Previous and new state of one output store during an ingest
+struct StoreIngestState {
+    FeatureStore previousStore;
+    IngestManifest previousManifest;
+    std::unordered_map<std::string_view, long> previousRows;
+    FeatureStoreWriter writer;
+    std::string tempStoreFile;
+    IngestManifest manifest;
+    std::atomic<long> reused{0};
+    std::atomic<long> computed{0};
+};
+
+} // namespace
+
+long runMultiStoreIngest(const std::string& inputDir, const std::vector<StoreTarget>& targets, const MultiFeatureFunction& compute,
+                         bool incremental, const IngestOptions& options) {
+    size_t storeCount = targets.size();
+    std::vector<std::unique_ptr<StoreIngestState>> stores;
+    for (const auto& target : targets) {
+        auto state = std::make_unique<StoreIngestState>();
+
+        // The previous store and manifest are only trusted together and for the same feature and scale
+        uint32_t decodeScale = std::max<uint32_t>(target.decodeScale, 1);
+        if (incremental) {
+            if (state->previousStore.open(target.storeFile) == 0 && state->previousStore.featureType() == target.featureType &&
+                state->previousStore.decodeScale() == decodeScale &&
+                loadIngestManifest(target.storeFile + ".manifest", state->previousManifest) == 0) {
+                state->previousRows.reserve(state->previousStore.size());
+                for (size_t i = 0; i < state->previousStore.size(); ++i) {
+                    state->previousRows.emplace(state->previousStore.name(i), static_cast<long>(i));
+                }
+            } else {
+                std::cout << "No usable manifest for " << target.storeFile << ", extracting every image" << std::endl;
+                state->previousManifest.clear();
+            }
+        }
+
+        // The new store is written beside the old one, which stays mapped until the run ends
+        state->tempStoreFile = target.storeFile + ".tmp";
+        if (state->writer.open(state->tempStoreFile, target.featureType, target.normalization) != 0) {
+            return -1;
+        }
+        state->writer.setDecodeScale(decodeScale);
+        stores.push_back(std::move(state));
+    }
+
+    std::mutex manifestMutex;
+
+    auto cachedCompute = [&](const fs::path& path, std::vector<std::vector<float>>& features) {
+        ManifestEntry entry;
+        if (statFile(path, entry) != 0) {
+            std::cerr << "Error: Unable to stat " << path << std::endl;
+            return false;
+        }
+
+        // Unchanged if size and mtime match; a touched but identical file is caught by its hash.
+        // The file is hashed at most once however many stores consult it.
+        std::string filename = path.filename().string();
+        bool haveHash = false;
+        std::vector<bool> needed(storeCount, true);
+        std::vector<long> rows(storeCount, -1);
+        bool anyNeeded = false;
+        for (size_t s = 0; s < storeCount; ++s) {
+            const StoreIngestState& state = *stores[s];
+            auto previous = state.previousManifest.find(filename);
+            auto row = state.previousRows.find(filename);
+            if (previous != state.previousManifest.end() && row != state.previousRows.end() && previous->second.size == entry.size) {
+                if (previous->second.mtime == entry.mtime) {
+                    needed[s] = false;
+                } else if (haveHash || hashFileContents(path, entry.hash) == 0) {
+                    haveHash = true;
+                    needed[s] = entry.hash != previous->second.hash;
+                }
+                if (!needed[s]) {
+                    rows[s] = row->second;
+                    if (!haveHash) {
+                        entry.hash = previous->second.hash;
+                        haveHash = true;
+                    }
+                }
+            }
+            anyNeeded = anyNeeded || needed[s];
+        }
+
+        features.assign(storeCount, std::vector<float>());
+        if (anyNeeded) {
+            if (!compute(path, needed, features)) {
+                return false;
+            }
+            if (!haveHash && hashFileContents(path, entry.hash) != 0) {
+                std::cerr << "Error: Unable to hash " << path << std::endl;
+                return false;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        for (size_t s = 0; s < storeCount; ++s) {
+            StoreIngestState& state = *stores[s];
+            if (needed[s]) {
+                ++state.computed;
+            } else {
+                const float* values = state.previousStore.row(rows[s]);
+                features[s].assign(values, values + state.previousStore.dim());
+                ++state.reused;
+            }
+            state.manifest[filename] = entry;
+        }
+        return true;
+    };
+
+    auto write = [&](const std::string& filename, const std::vector<std::vector<float>>& features) {
+        for (size_t s = 0; s < storeCount; ++s) {
+            stores[s]->writer.append(filename, features[s]);
+            if (targets[s].sink) {
+                targets[s].sink(filename, features[s]);
+            }
+        }
+    };
+
+    long written = runFeatureSetPipeline(inputDir, cachedCompute, write, options);
+
+    int status = written < 0 ? -1 : 0;
+    for (size_t s = 0; s < storeCount; ++s) {
+        StoreIngestState& state = *stores[s];
+        const std::string& storeFile = targets[s].storeFile;
+        if (written < 0) {
+            state.writer.close();
+            std::remove(state.tempStoreFile.c_str());
+            continue;
+        }
+        if (state.writer.close() != 0 || std::rename(state.tempStoreFile.c_str(), storeFile.c_str()) != 0) {
+            std::cerr << "Error: Unable to replace feature store " << storeFile << std::endl;
+            status = -1;
+            continue;
+        }
+        state.previousStore.close();
+
+        long dropped = 0;
+        for (const auto& item : state.previousManifest) {
+            if (state.manifest.find(item.first) == state.manifest.end()) {
+                ++dropped;
+            }
+        }
+        if (incremental) {
+            std::cout << storeFile << ": " << state.reused << " unchanged, " << state.computed << " extracted, " << dropped
+                      << " removed" << std::endl;
+        }
+        if (saveIngestManifest(storeFile + ".manifest", state.manifest) != 0) {
+            status = -1;
+        }
+    }
+    return status == 0 ? written : -1;
+}
+
+long runStoreIngest(const std::string& inputDir, const std::string& storeFile, const std::string& featureType, uint32_t normalization,
+                    const FeatureFunction& compute, const FeatureSink& sink, bool incremental, uint32_t decodeScale,
+                    const IngestOptions& options) {
+    std::vector<StoreTarget> targets = {{storeFile, featureType, normalization, sink, decodeScale}};
+    auto computeOne = [&](const fs::path& path, const std::vector<bool>&, std::vector<std::vector<float>>& features) {
+        return compute(path, features[0]);
+    };
+    return runMultiStoreIngest(inputDir, targets, computeOne, incremental, options);
+}
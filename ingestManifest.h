@@ -0,0 +1,75 @@
+/**
+
+ingestManifest.h
+Project 2
+
+Incremental ingest for the extractors. Next to every feature store a manifest
+records the size, modification time and content hash of each image the store was
+built from. An incremental run copies the stored vector of every image whose size
+and mtime (or, failing that, content hash) are unchanged, computes features only
+for new or changed images and drops images that are no longer in the directory.
+
+Manifest format (<storeFile>.manifest), one line per image:
+  size,mtimeNanoseconds,fnv1aHash,filename
+
+**/
+#ifndef INGESTMANIFEST_H
+#define INGESTMANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ingestPipeline.h"
+
+struct ManifestEntry {
+    uint64_t size = 0;
+    int64_t mtime = 0; // nanoseconds since the epoch
+    uint64_t hash = 0; // FNV-1a of the file contents
+};
+
+// Keyed by filename (no directory), as in the feature store
+using IngestManifest = std::unordered_map<std::string, ManifestEntry>;
+
+int loadIngestManifest(const std::string& path, IngestManifest& manifest);
+int saveIngestManifest(const std::string& path, const IngestManifest& manifest);
+
+#define FNV1A_OFFSET_BASIS 14695981039346656037ull
+
+// 64-bit FNV-1a hash of size bytes, continuing from hash
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = FNV1A_OFFSET_BASIS);
+
+// 64-bit FNV-1a hash of a file's contents; returns -1 if the file cannot be read
+int hashFileContents(const std::filesystem::path& path, uint64_t& hash);
+
+// One output store of a multi-store ingest; sink (may be empty) also receives its rows
+struct StoreTarget {
+    std::string storeFile;
+    std::string featureType;
+    uint32_t normalization;
+    FeatureSink sink;
+    uint32_t decodeScale = 1; // recorded in the store; a store with another scale is not reused
+};
+
+// Fill features[s] for every store s whose needed flag is set; the others are copied
+// from their previous store. Return false to skip the image in every store.
+using MultiFeatureFunction = std::function<bool(const std::filesystem::path& path, const std::vector<bool>& needed,
+                                                std::vector<std::vector<float>>& features)>;
+
+// Run the ingest pipeline into several stores at once, decoding each image at most once,
+// and rewrite their manifests. Returns the number of images written, or -1 on error.
+long runMultiStoreIngest(const std::string& inputDir, const std::vector<StoreTarget>& targets, const MultiFeatureFunction& compute,
+                         bool incremental, const IngestOptions& options = IngestOptions());
+
+// Run the ingest pipeline into storeFile and rewrite its manifest. With incremental
+// set, vectors of unchanged images are copied from the existing store instead of
+// recomputed. sink (may be empty) also receives every row, in directory order.
+// decodeScale records the reduced-resolution decode compute used.
+// Returns the number of rows written, or -1 on error.
+long runStoreIngest(const std::string& inputDir, const std::string& storeFile, const std::string& featureType, uint32_t normalization,
+                    const FeatureFunction& compute, const FeatureSink& sink, bool incremental, uint32_t decodeScale = 1,
+                    const IngestOptions& options = IngestOptions());
+
+#endif
@@ -0,0 +1,26 @@
+/**
+
+ingestPipeline.cpp
+Project 2
+
+Implementation of the list -> decode/compute -> ordered write ingest pipeline.
+
+**/
+
+#include "ingestPipeline.h"
+
+namespace fs = std::filesystem;
+
+bool isImageFile(const fs::path& path) {
+    return path.extension() == ".jpg" || path.extension() == ".png";
+}
+
+long runIngestPipeline(const std::string& inputDir, const FeatureFunction& compute, const FeatureSink& sink,
+                       const IngestOptions& options) {
+    return runOrderedPipeline<std::vector<float>>(inputDir, compute, sink, options);
+}
+
+long runFeatureSetPipeline(const std::string& inputDir, const FeatureSetFunction& compute, const FeatureSetSink& sink,
+                           const IngestOptions& options) {
+    return runOrderedPipeline<std::vector<std::vector<float>>>(inputDir, compute, sink, options);
+}
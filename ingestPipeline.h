@@ -0,0 +1,179 @@
+/**
+
+ingestPipeline.h
+Project 2
+
+Pipelined feature extraction shared by the extractors. A listing stage walks the
+image directory, a pool of workers decodes each image and computes its features,
+and a single writer stage hands the results to a sink in directory order as soon
+as they are ready. The stages are connected by bounded queues and the number of
+images in flight is capped, so memory use does not grow with the collection.
+
+**/
+#ifndef INGESTPIPELINE_H
+#define INGESTPIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "boundedQueue.h"
+
+// Decode one image and compute its features; return false to skip the file
+using FeatureFunction = std::function<bool(const std::filesystem::path& path, std::vector<float>& features)>;
+
+// Receives each computed feature vector, in directory order, on the writer thread
+using FeatureSink = std::function<void(const std::string& filename, const std::vector<float>& features)>;
+
+// Variant producing several feature vectors per image, e.g. one per output store
+using FeatureSetFunction = std::function<bool(const std::filesystem::path& path, std::vector<std::vector<float>>& features)>;
+using FeatureSetSink = std::function<void(const std::string& filename, const std::vector<std::vector<float>>& features)>;
+
+struct IngestOptions {
+    int workers = 0;         // 0 uses every hardware thread
+    size_t maxInFlight = 64; // images listed but not yet written
+};
+
+// True for the image types the extractors read
+bool isImageFile(const std::filesystem::path& path);
+
+// Run compute over every image in inputDir and deliver the results to sink.
+// Returns the number of images written, or -1 if the directory cannot be read.
+long runIngestPipeline(const std::string& inputDir, const FeatureFunction& compute, const FeatureSink& sink,
+                       const IngestOptions& options = IngestOptions());
+
+// Same pipeline for a compute function that fills several vectors per image
+long runFeatureSetPipeline(const std::string& inputDir, const FeatureSetFunction& compute, const FeatureSetSink& sink,
+                           const IngestOptions& options = IngestOptions());
+
+namespace ingest_detail {
+
+struct PathItem {
+    size_t sequence;
+    std::filesystem::path path;
+};
+
+template <typename Features>
+struct ResultItem {
+    size_t sequence;
+    bool ok;
+    std::string filename;
+    Features features;
+};
+
+// Caps the number of listed images that have not been written yet. The lister waits
+// here, so a slow image at the head of the order cannot let the reorder buffer grow.
+class InFlightWindow {
+public:
+    explicit InFlightWindow(size_t size) : size_(size > 0 ? size : 1) {}
+
+    void waitFor(size_t sequence) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return sequence < written_ + size_; });
+    }
+
+    void advance(size_t written) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        written_ = written;
+        changed_.notify_all();
+    }
+
+private:
+    size_t size_;
+    size_t written_ = 0;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+} // namespace ingest_detail
+
+// The pipeline for any per-image result type, e.g. a processed cv::Mat: compute runs on the
+// workers, sink receives the results in directory order on the calling thread. Returns the
+// number of results delivered to sink, or -1 if the directory cannot be read.
+template <typename Features>
+long runOrderedPipeline(const std::string& inputDir, const std::function<bool(const std::filesystem::path&, Features&)>& compute,
+                        const std::function<void(const std::string&, const Features&)>& sink, const IngestOptions& options) {
+    using namespace ingest_detail;
+
+    std::error_code ec;
+    std::filesystem::directory_iterator dir(inputDir, ec);
+    if (ec) {
+        std::cerr << "Error: Unable to read directory " << inputDir << ": " << ec.message() << std::endl;
+        return -1;
+    }
+
+    int workerCount = options.workers > 0 ? options.workers : static_cast<int>(std::thread::hardware_concurrency());
+    workerCount = std::max(workerCount, 1);
+
+    BoundedQueue<PathItem> paths(options.maxInFlight);
+    BoundedQueue<ResultItem<Features>> results(options.maxInFlight);
+    InFlightWindow window(options.maxInFlight);
+
+    // Listing stage
+    std::thread lister([&] {
+        size_t sequence = 0;
+        for (const auto& entry : dir) {
+            if (!isImageFile(entry.path())) {
+                continue;
+            }
+            window.waitFor(sequence);
+            paths.push({sequence++, entry.path()});
+        }
+        paths.close();
+    });
+
+    // Decode and feature workers
+    std::atomic<int> running(workerCount);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&] {
+            PathItem item;
+            while (paths.pop(item)) {
+                ResultItem<Features> result{item.sequence, false, item.path.filename().string(), {}};
+                try {
+                    result.ok = compute(item.path, result.features);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Unable to process " << item.path << ": " << e.what() << std::endl;
+                }
+                results.push(std::move(result));
+            }
+            if (--running == 0) {
+                results.close();
+            }
+        });
+    }
+
+    // Ordered writer stage, runs on the calling thread
+    std::map<size_t, ResultItem<Features>> pending;
+    size_t nextSequence = 0;
+    long written = 0;
+    ResultItem<Features> result;
+    while (results.pop(result)) {
+        pending.emplace(result.sequence, std::move(result));
+        for (auto it = pending.begin(); it != pending.end() && it->first == nextSequence; it = pending.erase(it)) {
+            if (it->second.ok) {
+                sink(it->second.filename, it->second.features);
+                ++written;
+            }
+            ++nextSequence;
+        }
+        window.advance(nextSequence);
+    }
+
+    lister.join();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return written;
+}
+
+#endif
@@ -0,0 +1,198 @@
+/**
+
+ivfIndex.cpp
+Project 2
+
+Implementation of the IVF coarse-quantized index over the ResNet18 embeddings.
+
+**/
+
+#include "ivfIndex.h"
+#include "distanceKernels.h"
+#include "searchRecall.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "kmeans.h"
+
+#define IVF_MAGIC "CBIRIVF1"
+
+int IvfIndex::build(const FeatureStore& store, int numLists, int maxIterations, size_t trainingSample) {
+    size_t rows = store.size();
+    dim_ = store.dim();
+    if (numLists <= 0 || rows < static_cast<size_t>(numLists)) {
+        std::cerr << "Error: IVF needs between 1 and " << rows << " lists" << std::endl;
+        return -1;
+    }
+
+    // Train on an evenly spaced sample of the collection
+    size_t sampleSize = trainingSample > 0 ? std::min(trainingSample, rows) : rows;
+    sampleSize = std::max(sampleSize, static_cast<size_t>(numLists));
+    std::vector<float> sample(sampleSize * dim_);
+    for (size_t i = 0; i < sampleSize; ++i) {
+        const float* row = store.row(i * rows / sampleSize);
+        std::copy(row, row + dim_, sample.begin() + i * dim_);
+    }
+
+    std::vector<int> sampleLabels(sampleSize);
+    if (kmeans(sample.data(), static_cast<int>(sampleSize), static_cast<int>(dim_), centroids_, sampleLabels.data(), numLists, maxIterations) != 0) {
+        return -1;
+    }
+
+    // Assign every vector to its nearest centroid
+    std::vector<int> labels(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        const float* row = store.row(i);
+        float best = ssdDistance(centroids_.data(), row, dim_);
+        int bestList = 0;
+        for (int c = 1; c < numLists; ++c) {
+            float d = ssdDistance(&centroids_[static_cast<size_t>(c) * dim_], row, dim_);
+            if (d < best) {
+                best = d;
+                bestList = c;
+            }
+        }
+        labels[i] = bestList;
+    }
+
+    groupVectors(store, labels);
+    return 0;
+}
+
+void IvfIndex::groupVectors(const FeatureStore& store, const std::vector<int>& labels) {
+    int lists = static_cast<int>(centroids_.size() / dim_);
+
+    // Counting sort of the row ids by list
+    listOffsets_.assign(lists + 1, 0);
+    for (int label : labels) {
+        listOffsets_[label + 1]++;
+    }
+    for (int c = 0; c < lists; ++c) {
+        listOffsets_[c + 1] += listOffsets_[c];
+    }
+
+    std::vector<uint32_t> fill(listOffsets_.begin(), listOffsets_.end() - 1);
+    ids_.assign(labels.size(), 0);
+    vectors_.assign(labels.size() * dim_, 0.0f);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        uint32_t slot = fill[labels[i]]++;
+        ids_[slot] = static_cast<uint32_t>(i);
+        std::copy(store.row(i), store.row(i) + dim_, vectors_.begin() + static_cast<size_t>(slot) * dim_);
+    }
+}
+
+int IvfIndex::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write IVF index " << path << std::endl;
+        return -1;
+    }
+
+    uint32_t lists = numLists();
+    uint64_t count = ids_.size();
+    file.write(IVF_MAGIC, 8);
+    file.write(reinterpret_cast<const char*>(&dim_), sizeof(dim_));
+    file.write(reinterpret_cast<const char*>(&lists), sizeof(lists));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(centroids_.data()), centroids_.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(listOffsets_.data()), listOffsets_.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(ids_.data()), ids_.size() * sizeof(uint32_t));
+    return file.good() ? 0 : -1;
+}
+
+int IvfIndex::load(const std::string& path, const FeatureStore& store) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return -1;
+    }
+    uint64_t fileBytes = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    char magic[8];
+    uint32_t lists = 0;
+    uint64_t count = 0;
+    file.read(magic, 8);
+    file.read(reinterpret_cast<char*>(&dim_), sizeof(dim_));
+    file.read(reinterpret_cast<char*>(&lists), sizeof(lists));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, IVF_MAGIC, 8) != 0 || lists == 0 || dim_ != store.dim() || count != store.size()) {
+        std::cerr << "Error: IVF index " << path << " does not match the feature store" << std::endl;
+        return -1;
+    }
+
+    // The header sizes the arrays, so they are checked against the file before anything is allocated
+    uint64_t headerBytes = 8 + sizeof(dim_) + sizeof(lists) + sizeof(count);
+    uint64_t payloadBytes = (static_cast<uint64_t>(lists) * dim_ + lists + 1 + count) * sizeof(uint32_t);
+    if (fileBytes - headerBytes != payloadBytes) {
+        std::cerr << "Error: IVF index " << path << " is truncated or corrupt" << std::endl;
+        return -1;
+    }
+
+    centroids_.resize(static_cast<size_t>(lists) * dim_);
+    listOffsets_.resize(lists + 1);
+    std::vector<uint32_t> ids(count);
+    file.read(reinterpret_cast<char*>(centroids_.data()), centroids_.size() * sizeof(float));
+    file.read(reinterpret_cast<char*>(listOffsets_.data()), listOffsets_.size() * sizeof(uint32_t));
+    file.read(reinterpret_cast<char*>(ids.data()), ids.size() * sizeof(uint32_t));
+
+    // The lists must partition the store rows: offsets ascend from 0 to count and every id is used once
+    bool valid = file && listOffsets_[0] == 0 && listOffsets_[lists] == count;
+    for (uint32_t c = 0; valid && c < lists; ++c) {
+        valid = listOffsets_[c] <= listOffsets_[c + 1];
+    }
+    std::vector<bool> seen(valid ? count : 0, false);
+    for (size_t slot = 0; valid && slot < ids.size(); ++slot) {
+        valid = ids[slot] < count && !seen[ids[slot]];
+        if (valid) {
+            seen[ids[slot]] = true;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Error: IVF index " << path << " is truncated or corrupt" << std::endl;
+        centroids_.clear();
+        listOffsets_.clear();
+        return -1;
+    }
+
+    // Rebuild the per-row labels and regroup the vectors from the store
+    std::vector<int> labels(count);
+    for (uint32_t c = 0; c < lists; ++c) {
+        for (uint32_t slot = listOffsets_[c]; slot < listOffsets_[c + 1]; ++slot) {
+            labels[ids[slot]] = static_cast<int>(c);
+        }
+    }
+    groupVectors(store, labels);
+    return 0;
+}
+
+void IvfIndex::search(const float* query, int nprobe, TopK& result, long excludeId) const {
+    int lists = numLists();
+    nprobe = std::max(1, std::min(nprobe, lists));
+
+    // Rank the centroids and keep the nprobe nearest
+    TopK nearestLists(nprobe);
+    for (int c = 0; c < lists; ++c) {
+        nearestLists.push(static_cast<uint32_t>(c), ssdDistance(&centroids_[static_cast<size_t>(c) * dim_], query, dim_));
+    }
+
+    // Scan the selected lists; their vectors are contiguous in memory
+    for (const auto& list : nearestLists.sorted()) {
+        for (uint32_t slot = listOffsets_[list.id]; slot < listOffsets_[list.id + 1]; ++slot) {
+            if (static_cast<long>(ids_[slot]) == excludeId) {
+                continue;
+            }
+            result.push(ids_[slot], dotProduct(query, &vectors_[static_cast<size_t>(slot) * dim_], dim_));
+        }
+    }
+}
+
+float measureIvfRecall(const IvfIndex& index, const FeatureStore& store, int k, int nprobe, int numQueries, double* meanQueryMs) {
+    return measureSearchRecall(store, k, numQueries, [&](const float* query, long excludeId, TopK& result) {
+        index.search(query, nprobe, result, excludeId);
+    }, meanQueryMs);
+}
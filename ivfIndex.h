@@ -0,0 +1,52 @@
+/**
+
+ivfIndex.h
+Project 2
+
+Inverted-file (IVF) index for the ResNet18 embeddings. The vectors of an
+L2-normalized feature store are clustered with kmeans() into numLists coarse
+centroids and each vector is filed under its nearest centroid. A query ranks the
+centroids and scans only the nprobe closest lists, so its cost grows with
+nprobe / numLists of the collection instead of the whole collection.
+
+**/
+#ifndef IVFINDEX_H
+#define IVFINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "featureStore.h"
+#include "topK.h"
+
+class IvfIndex {
+public:
+    // Cluster the rows of an L2-normalized store; trainingSample = 0 trains on every row
+    int build(const FeatureStore& store, int numLists, int maxIterations = 10, size_t trainingSample = 0);
+
+    // Index files hold the centroids and list membership; vectors are regrouped from the store
+    int save(const std::string& path) const;
+    int load(const std::string& path, const FeatureStore& store);
+
+    // Cosine similarity search of a unit-length query over the nprobe nearest lists.
+    // Scores are dot products (larger is better); excludeId is skipped, -1 skips nothing.
+    void search(const float* query, int nprobe, TopK& result, long excludeId = -1) const;
+
+    int numLists() const { return static_cast<int>(listOffsets_.empty() ? 0 : listOffsets_.size() - 1); }
+    uint32_t dim() const { return dim_; }
+
+private:
+    void groupVectors(const FeatureStore& store, const std::vector<int>& labels);
+
+    uint32_t dim_ = 0;
+    std::vector<float> centroids_;      // numLists x dim
+    std::vector<uint32_t> listOffsets_; // numLists + 1 offsets into ids_ and vectors_
+    std::vector<uint32_t> ids_;         // store row ids grouped by list
+    std::vector<float> vectors_;        // copies of the vectors in the same order as ids_
+};
+
+// Fraction of the exact top-k that the IVF search also returns, averaged over numQueries
+// queries drawn from the store, together with the mean query time in milliseconds
+float measureIvfRecall(const IvfIndex& index, const FeatureStore& store, int k, int nprobe, int numQueries, double* meanQueryMs = nullptr);
+
+#endif
@@ -12,6 +12,7 @@
 #include <cstring>
 #include <opencv2/opencv.hpp>
 #include "kmeans.h"
+#include "kmeansEngine.h"
 
 /*
   data: a std::vector of pixels
@@ -21,77 +22,54 @@
   maxIterations: maximum number of E-M interactions, default is 10
   stopThresh: if the means change less than the threshold, the E-M loop terminates, default is 0
 
-  Executes K-means clustering on the data
+  Executes K-means clustering on the data with the parallel engine in kmeansEngine.h,
+  seeded with k-means++
  */
 
 int kmeans( std::vector<cv::Vec3b> &data, std::vector<cv::Vec3b> &means, int *labels, int K, int maxIterations, int stopThresh ) {
 
-  // error checking
-  if( K > data.size() ) {
-    printf("error: K must be less than the number of data points\n");
+  // the pixels are packed 3-byte vectors, cluster them in place
+  static_assert( sizeof(cv::Vec3b) == 3, "cv::Vec3b must be 3 packed bytes" );
+  KmeansOptions options;
+  options.maxIterations = maxIterations;
+  options.stopThresh = (float)stopThresh;
+
+  std::vector<float> centers;
+  if( kmeansCluster( reinterpret_cast<const uint8_t *>( data.data() ), data.size(), 3, K, centers, labels, options ) != 0 ) {
     return(-1);
   }
 
-  // clear the means vector
+  // round the means back to pixel values
   means.clear();
-
-  // initialize the K mean values
-  // use comb sampling to select K values
-  int delta = data.size() / K;
-  int istep = rand() % (data.size() % K);
-  for(int i=0;i<K;i++) {
-    int index = (istep + i*delta) % data.size();
-    means.push_back( data[index] );
+  for(int k=0;k<K;k++) {
+    means.push_back( cv::Vec3b( cv::saturate_cast<uchar>( centers[3*k] ),
+				cv::saturate_cast<uchar>( centers[3*k+1] ),
+				cv::saturate_cast<uchar>( centers[3*k+2] ) ) );
   }
-  // have K initial means
-
-  // loop the E-M steps
-  for(int i=0;i<maxIterations;i++) {
-
-    // classify each data point using SSD
-    for(int j=0;j<data.size();j++) {
-      int minssd = SSD( means[0], data[j] );
-      int minidx = 0;
-      for(int k=1;k<K;k++) {
-	int tssd = SSD( means[k], data[j] );
-	if( tssd < minssd ) {
-	  minssd = tssd;
-	  minidx = k;
-	}
-      }
-      labels[j] = minidx;
-    }
-
-    // calculate the new means
-    std::vector<cv::Vec4i> tmeans(means.size(), cv::Vec4i(0, 0, 0, 0) ); // initialize with zeros
-    for(int j=0;j<data.size();j++) {
-      tmeans[ labels[j] ][0] += data[j][0];
-      tmeans[ labels[j] ][1] += data[j][1];
-      tmeans[ labels[j] ][2] += data[j][2];
-      tmeans[ labels[j] ][3] ++; // counter
-    }
-    
-    int sum = 0;
-    for(int k=0;k<tmeans.size();k++) {
-      tmeans[k][0] /= tmeans[k][3];
-      tmeans[k][1] /= tmeans[k][3];
-      tmeans[k][2] /= tmeans[k][3];
-
-      // compute the SSD between the new and old means
-      sum += SSD( tmeans[k], means[k] );
-
-      means[k][0] = tmeans[k][0]; // update the mean
-      means[k][1] = tmeans[k][1]; // update the mean
-      means[k][2] = tmeans[k][2]; // update the mean
-    }
-
-    // check if we can stop early
-    if( sum <= stopThresh ) {
-      break;
-    }
-  }
-
-  // the labels and updated means are the final values
 
   return(0);
 }
+
+
+/*
+  data: numPoints float vectors of length dim, stored row after row
+  numPoints: the number of vectors
+  dim: the length of each vector
+  means: will contain the K cluster means (K x dim, row after row) when the function returns
+  labels: an allocated array of type int, numPoints long, contains the labels when the function returns
+  K: the number of clusters
+  maxIterations: maximum number of E-M interactions, default is 10
+  stopThresh: if the summed squared movement of the means is at most this value, the E-M loop terminates, default is 0
+
+  Executes K-means clustering on float vectors of any dimension with the parallel engine
+  in kmeansEngine.h, seeded with k-means++
+ */
+
+int kmeans( const float *data, int numPoints, int dim, std::vector<float> &means, int *labels, int K, int maxIterations, float stopThresh ) {
+
+  KmeansOptions options;
+  options.maxIterations = maxIterations;
+  options.stopThresh = stopThresh;
+
+  return( kmeansCluster( data, numPoints > 0 ? numPoints : 0, dim, K, means, labels, options ) );
+}
@@ -12,5 +12,8 @@
 
 int kmeans( std::vector<cv::Vec3b> &data, std::vector<cv::Vec3b> &means, int *labels, int K, int maxIterations=10, int stopThresh=0 );
 
+// K-means on numPoints float vectors of length dim stored row after row in data
+int kmeans( const float *data, int numPoints, int dim, std::vector<float> &means, int *labels, int K, int maxIterations=10, float stopThresh=0 );
+
 
 #endif
@@ -0,0 +1,358 @@
+/**
+
+kmeansEngine.cpp
+Project 2
+
+Implementation of the parallel k-means engine.
+
+**/
+
+#include "kmeansEngine.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
+
+namespace {
+
+// Means of at most this many floats are searched one point against all means at once
+const int SHORT_VECTOR_DIM = 16;
+
+// Below this many points per thread the pass runs on fewer threads
+const size_t MIN_POINTS_PER_THREAD = 4096;
+
+int threadCount(int requested, size_t work) {
+    int threads = requested > 0 ? requested : static_cast<int>(std::thread::hardware_concurrency());
+    size_t useful = std::max<size_t>(1, work / MIN_POINTS_PER_THREAD);
+    return static_cast<int>(std::max<size_t>(1, std::min<size_t>(std::max(threads, 1), useful)));
+}
+
+// Run fn(thread, begin, end) over threads contiguous chunks of [0, n); thread 0 is the caller
+template <typename Fn>
+void parallelChunks(size_t n, int threads, Fn fn) {
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back(fn, t, n * t / threads, n * (t + 1) / threads);
+    }
+    fn(0, 0, n / threads);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+// Squared distances from x to every mean of a dim x paddedK (transposed) table
+void transposedDistancesScalar(const float* transposed, int paddedK, int dim, const float* x, float* distances) {
+    std::fill(distances, distances + paddedK, 0.0f);
+    for (int d = 0; d < dim; ++d) {
+        const float* row = transposed + static_cast<size_t>(d) * paddedK;
+        for (int k = 0; k < paddedK; ++k) {
+            float diff = row[k] - x[d];
+            distances[k] += diff * diff;
+        }
+    }
+}
+
+#ifdef CBIR_X86_SIMD
+CBIR_TARGET_AVX2 void transposedDistancesAvx2(const float* transposed, int paddedK, int dim, const float* x, float* distances) {
+    for (int k = 0; k < paddedK; k += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int d = 0; d < dim; ++d) {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(transposed + static_cast<size_t>(d) * paddedK + k), _mm256_set1_ps(x[d]));
+            sum = _mm256_fmadd_ps(diff, diff, sum);
+        }
+        _mm256_storeu_ps(distances + k, sum);
+    }
+}
+#endif
+
+typedef void (*TransposedDistances)(const float*, int, int, const float*, float*);
+
+TransposedDistances transposedDistances() {
+    static const TransposedDistances kernel = [] {
+#ifdef CBIR_X86_SIMD
+        if (detectSimdLevel() >= SIMD_AVX2) {
+            return transposedDistancesAvx2;
+        }
+#endif
+        return transposedDistancesScalar;
+    }();
+    return kernel;
+}
+
+// The current means, laid out for nearest-mean search
+class MeanTable {
+public:
+    MeanTable(const std::vector<float>& means, int K, int dim) : means_(means.data()), K_(K), dim_(dim), paddedK_((K + 7) / 8 * 8) {
+        if (dim_ < SHORT_VECTOR_DIM) {
+            transposed_.assign(static_cast<size_t>(dim_) * paddedK_, 0.0f);
+            for (int k = 0; k < K_; ++k) {
+                for (int d = 0; d < dim_; ++d) {
+                    transposed_[static_cast<size_t>(d) * paddedK_ + k] = means[static_cast<size_t>(k) * dim_ + d];
+                }
+            }
+        }
+    }
+
+    // Scratch floats nearest() needs per thread
+    int scratchSize() const { return paddedK_; }
+
+    int nearest(const float* x, float* scratch, float& distance) const {
+        int best = 0;
+        distance = std::numeric_limits<float>::max();
+        if (!transposed_.empty()) {
+            transposedDistances()(transposed_.data(), paddedK_, dim_, x, scratch);
+            for (int k = 0; k < K_; ++k) {
+                if (scratch[k] < distance) {
+                    distance = scratch[k];
+                    best = k;
+                }
+            }
+        } else {
+            for (int k = 0; k < K_; ++k) {
+                float d = ssdDistance(means_ + static_cast<size_t>(k) * dim_, x, dim_);
+                if (d < distance) {
+                    distance = d;
+                    best = k;
+                }
+            }
+        }
+        return best;
+    }
+
+private:
+    const float* means_;
+    int K_;
+    int dim_;
+    int paddedK_;
+    std::vector<float> transposed_;
+};
+
+// Point i as floats: float data is used in place, uint8 data is widened into scratch
+inline const float* pointAsFloat(const float* data, size_t i, int dim, float*) {
+    return data + i * dim;
+}
+
+inline const float* pointAsFloat(const uint8_t* data, size_t i, int dim, float* scratch) {
+    const uint8_t* point = data + i * dim;
+    for (int d = 0; d < dim; ++d) {
+        scratch[d] = point[d];
+    }
+    return scratch;
+}
+
+// Per-thread partial sums of one assignment pass
+struct PartialSums {
+    std::vector<double> sums;
+    std::vector<size_t> counts;
+
+    void reset(int K, int dim) {
+        sums.assign(static_cast<size_t>(K) * dim, 0.0);
+        counts.assign(K, 0);
+    }
+};
+
+// Assign the points listed in indices (or all points if indices is null) and accumulate per-thread sums
+template <typename T>
+void assignAndAccumulate(const T* data, int dim, const MeanTable& table, int K, const size_t* indices, size_t n,
+                         int* labels, std::vector<PartialSums>& partials) {
+    int threads = static_cast<int>(partials.size());
+    parallelChunks(n, threads, [&](int t, size_t begin, size_t end) {
+        PartialSums& partial = partials[t];
+        partial.reset(K, dim);
+        std::vector<float> point(dim), scratch(table.scratchSize());
+        for (size_t j = begin; j < end; ++j) {
+            size_t i = indices ? indices[j] : j;
+            const float* x = pointAsFloat(data, i, dim, point.data());
+            float distance;
+            int label = table.nearest(x, scratch.data(), distance);
+            if (labels) {
+                labels[i] = label;
+            }
+            double* sum = &partial.sums[static_cast<size_t>(label) * dim];
+            for (int d = 0; d < dim; ++d) {
+                sum[d] += x[d];
+            }
+            ++partial.counts[label];
+        }
+    });
+
+    // Reduce into partials[0], in thread order so the result does not depend on timing
+    for (int t = 1; t < threads; ++t) {
+        for (size_t v = 0; v < partials[0].sums.size(); ++v) {
+            partials[0].sums[v] += partials[t].sums[v];
+        }
+        for (int k = 0; k < K; ++k) {
+            partials[0].counts[k] += partials[t].counts[k];
+        }
+    }
+}
+
+template <typename T>
+void seedMeans(const T* data, size_t numPoints, int dim, int K, const KmeansOptions& options, std::mt19937& rng, std::vector<float>& means) {
+    means.assign(static_cast<size_t>(K) * dim, 0.0f);
+    std::vector<float> point(dim);
+    auto copyPoint = [&](int k, size_t i) {
+        const float* x = pointAsFloat(data, i, dim, point.data());
+        std::copy(x, x + dim, means.begin() + static_cast<size_t>(k) * dim);
+    };
+
+    if (!options.kmeansPlusPlus) {
+        // Comb sampling: every delta-th point from a random start
+        size_t delta = numPoints / K;
+        size_t start = rng() % delta;
+        for (int k = 0; k < K; ++k) {
+            copyPoint(k, (start + k * delta) % numPoints);
+        }
+        return;
+    }
+
+    // k-means++ on an evenly spaced sample of the data
+    size_t sampleSize = options.seedingSample > 0 ? options.seedingSample : static_cast<size_t>(K) * 256;
+    sampleSize = std::max(std::min(sampleSize, numPoints), static_cast<size_t>(K));
+    size_t offset = rng() % (numPoints / sampleSize);
+    std::vector<float> sample(sampleSize * dim);
+    for (size_t s = 0; s < sampleSize; ++s) {
+        const float* x = pointAsFloat(data, s * numPoints / sampleSize + offset, dim, point.data());
+        std::copy(x, x + dim, sample.begin() + s * dim);
+    }
+
+    // Squared distance of every sample point to its nearest chosen mean
+    std::vector<float> nearest(sampleSize, std::numeric_limits<float>::max());
+    int threads = threadCount(options.threads, sampleSize);
+    size_t chosen = rng() % sampleSize;
+    for (int k = 0; k < K; ++k) {
+        const float* mean = &sample[chosen * dim];
+        std::copy(mean, mean + dim, means.begin() + static_cast<size_t>(k) * dim);
+        if (k + 1 == K) {
+            break;
+        }
+
+        std::vector<double> partialTotals(threads, 0.0);
+        parallelChunks(sampleSize, threads, [&](int t, size_t begin, size_t end) {
+            double total = 0.0;
+            for (size_t s = begin; s < end; ++s) {
+                nearest[s] = std::min(nearest[s], ssdDistance(mean, &sample[s * dim], dim));
+                total += nearest[s];
+            }
+            partialTotals[t] = total;
+        });
+        double total = 0.0;
+        for (double partial : partialTotals) {
+            total += partial;
+        }
+
+        // Next mean with probability proportional to its squared distance; any point if all are covered
+        if (total <= 0.0) {
+            chosen = rng() % sampleSize;
+            continue;
+        }
+        double target = std::uniform_real_distribution<double>(0.0, total)(rng);
+        chosen = sampleSize - 1;
+        for (size_t s = 0; s < sampleSize; ++s) {
+            target -= nearest[s];
+            if (target < 0.0) {
+                chosen = s;
+                break;
+            }
+        }
+    }
+}
+
+template <typename T>
+int cluster(const T* data, size_t numPoints, int dim, int K, std::vector<float>& means, int* labels, const KmeansOptions& options) {
+    if (K <= 0 || static_cast<size_t>(K) > numPoints || dim <= 0) {
+        std::cerr << "Error: K must be between 1 and the number of data points" << std::endl;
+        return -1;
+    }
+
+    std::mt19937 rng(options.seed);
+    seedMeans(data, numPoints, dim, K, options, rng, means);
+
+    bool miniBatch = options.miniBatch > 0 && options.miniBatch < numPoints;
+    size_t passSize = miniBatch ? options.miniBatch : numPoints;
+    std::vector<PartialSums> partials(threadCount(options.threads, passSize));
+    std::vector<size_t> batch(miniBatch ? passSize : 0);
+    std::vector<double> seen(miniBatch ? K : 0, 0.0);
+
+    for (int iteration = 0; iteration < options.maxIterations; ++iteration) {
+        MeanTable table(means, K, dim);
+        if (miniBatch) {
+            for (size_t& index : batch) {
+                index = rng() % numPoints;
+            }
+            assignAndAccumulate(data, dim, table, K, batch.data(), passSize, nullptr, partials);
+        } else {
+            assignAndAccumulate(data, dim, table, K, nullptr, passSize, labels, partials);
+        }
+
+        // Lloyd: mean of the cluster. Mini-batch: move toward the batch mean with a per-mean
+        // learning rate of batch count / points seen so far. Empty clusters keep their mean.
+        const PartialSums& totals = partials[0];
+        float movement = 0.0f;
+        for (int k = 0; k < K; ++k) {
+            size_t count = totals.counts[k];
+            if (count == 0) {
+                continue;
+            }
+            double rate = 1.0;
+            if (miniBatch) {
+                seen[k] += count;
+                rate = count / seen[k];
+            }
+            float* mean = &means[static_cast<size_t>(k) * dim];
+            const double* sum = &totals.sums[static_cast<size_t>(k) * dim];
+            for (int d = 0; d < dim; ++d) {
+                float updated = static_cast<float>(mean[d] + rate * (sum[d] / count - mean[d]));
+                movement += (updated - mean[d]) * (updated - mean[d]);
+                mean[d] = updated;
+            }
+        }
+
+        if (movement <= options.stopThresh) {
+            break;
+        }
+    }
+
+    // Mini-batch steps only saw samples; label every point against the final means
+    if (labels && (miniBatch || options.maxIterations <= 0)) {
+        kmeansAssign(data, numPoints, dim, means, K, labels, nullptr, options.threads);
+    }
+    return 0;
+}
+
+template <typename T>
+void assign(const T* data, size_t numPoints, int dim, const std::vector<float>& means, int K, int* labels, float* distances, int threads) {
+    MeanTable table(means, K, dim);
+    parallelChunks(numPoints, threadCount(threads, numPoints), [&](int, size_t begin, size_t end) {
+        std::vector<float> point(dim), scratch(table.scratchSize());
+        for (size_t i = begin; i < end; ++i) {
+            float distance;
+            labels[i] = table.nearest(pointAsFloat(data, i, dim, point.data()), scratch.data(), distance);
+            if (distances) {
+                distances[i] = distance;
+            }
+        }
+    });
+}
+
+} // namespace
+
+int kmeansCluster(const float* data, size_t numPoints, int dim, int K, std::vector<float>& means, int* labels, const KmeansOptions& options) {
+    return cluster(data, numPoints, dim, K, means, labels, options);
+}
+
+int kmeansCluster(const uint8_t* data, size_t numPoints, int dim, int K, std::vector<float>& means, int* labels, const KmeansOptions& options) {
+    return cluster(data, numPoints, dim, K, means, labels, options);
+}
+
+void kmeansAssign(const float* data, size_t numPoints, int dim, const std::vector<float>& means, int K, int* labels, float* distances, int threads) {
+    assign(data, numPoints, dim, means, K, labels, distances, threads);
+}
+
+void kmeansAssign(const uint8_t* data, size_t numPoints, int dim, const std::vector<float>& means, int K, int* labels, float* distances, int threads) {
+    assign(data, numPoints, dim, means, K, labels, distances, threads);
+}
@@ -0,0 +1,49 @@
+/**
+
+kmeansEngine.h
+Project 2
+
+K-means clustering engine behind kmeans() and the index training. Points are float
+or uint8 vectors of any dimension. Assignment and the mean update run in one pass
+over contiguous chunks of the data, one chunk per thread, each thread accumulating
+its own partial sums that are reduced after the pass. Distances to the means use
+the SIMD kernels: one point against all means at once for short vectors (pixels),
+ssdDistance for long ones.
+
+Seeding is k-means++ (D^2 sampling, on a sample of the data for large inputs) or
+the original comb sampling. Mini-batch mode updates the means from a random batch
+per step instead of the whole data set and labels every point once at the end.
+
+**/
+#ifndef KMEANSENGINE_H
+#define KMEANSENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct KmeansOptions {
+    int maxIterations = 10;      // Lloyd iterations, or mini-batch steps
+    float stopThresh = 0.0f;     // stop once the summed squared movement of the means is at most this
+    bool kmeansPlusPlus = true;  // D^2 seeding; false uses comb sampling
+    size_t seedingSample = 0;    // points k-means++ seeds from; 0 uses min(numPoints, 256 * K)
+    size_t miniBatch = 0;        // points per mini-batch step; 0 runs full Lloyd iterations
+    int threads = 0;             // 0 uses every hardware thread
+    unsigned seed = 1;
+};
+
+// Cluster numPoints vectors of length dim, stored row after row, into K clusters. means
+// receives K x dim floats; labels (numPoints ints, may be null) the cluster of every point.
+// Returns -1 if K is not between 1 and numPoints.
+int kmeansCluster(const float* data, size_t numPoints, int dim, int K, std::vector<float>& means, int* labels,
+                  const KmeansOptions& options = KmeansOptions());
+int kmeansCluster(const uint8_t* data, size_t numPoints, int dim, int K, std::vector<float>& means, int* labels,
+                  const KmeansOptions& options = KmeansOptions());
+
+// Label every point with its nearest of the K means; distances (may be null) receives the squared distances
+void kmeansAssign(const float* data, size_t numPoints, int dim, const std::vector<float>& means, int K, int* labels,
+                  float* distances = nullptr, int threads = 0);
+void kmeansAssign(const uint8_t* data, size_t numPoints, int dim, const std::vector<float>& means, int K, int* labels,
+                  float* distances = nullptr, int threads = 0);
+
+#endif
@@ -7,130 +7,125 @@ Created by Ruohe Zhou and Rucha Pendharkar on 2/8/24
 This code is used for Task 3. The code used two RGB histograms, 
 representing the top and bottom halves of the image, 
 using 8 bins for each of RGB and histogram intersection as the distance metric.
+--layout replaces the top/bottom halves with another spatial layout (see
+spatialHistogram.h), e.g. --layout 2x2 or --layout pyramid:3.
 
 
 **/
 
 #include <opencv2/opencv.hpp>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <vector>
+#include "featureStore.h"
+#include "ingestPipeline.h"
+#include "ingestManifest.h"
+#include "distanceKernels.h"
+#include "spatialHistogram.h"
+#include "featureRegistry.h"
 
 namespace fs = std::filesystem;
 
-// Structure to hold image features
-struct ImageFeatures {
-    std::string filename;
-    std::vector<float> featuresTop;
-    std::vector<float> featuresBottom;
-};
-
-// Compute RGB histograms for top and bottom halves of an image
-void computeFeatures(cv::Mat& image, std::vector<float>& featuresTop, std::vector<float>& featuresBottom) {
-    // Define regions of interest for top and bottom halves
-    cv::Rect topRect(0, 0, image.cols, image.rows / 2);
-    cv::Rect bottomRect(0, image.rows / 2, image.cols, image.rows / 2);
-
-    // Split the image into regions
-    cv::Mat topRegion = image(topRect);
-    cv::Mat bottomRegion = image(bottomRect);
-
-    // Compute histograms for each region
-    int bins = 8;
-    int histSize[] = {bins, bins, bins};
-    float range[] = {0, 256}; // Range for each channel
-    const float* ranges[] = {range, range, range};
-    int channels[] = {0, 1, 2}; // All channels
-
-    // Compute histogram for top region
-    cv::Mat histTop;
-    cv::calcHist(&topRegion, 1, channels, cv::Mat(), histTop, 3, histSize, ranges);
-    cv::normalize(histTop, histTop, 0, 1, cv::NORM_MINMAX);
-    histTop = histTop.reshape(1, 1); // Flatten histogram
-
-    // Compute histogram for bottom region
-    cv::Mat histBottom;
-    cv::calcHist(&bottomRegion, 1, channels, cv::Mat(), histBottom, 3, histSize, ranges);
-    cv::normalize(histBottom, histBottom, 0, 1, cv::NORM_MINMAX);
-    histBottom = histBottom.reshape(1, 1); // Flatten histogram
-
-    // Convert histograms to vector<float>
-    featuresTop.assign(histTop.begin<float>(), histTop.end<float>());
-    featuresBottom.assign(histBottom.begin<float>(), histBottom.end<float>());
-}
-
 // Compute histogram intersection distance between two histograms
 float computeHistogramIntersection(const std::vector<float>& hist1, const std::vector<float>& hist2) {
-    float distance = 0.0f;
-    for (size_t i = 0; i < hist1.size(); ++i) {
-        distance += std::min(hist1[i], hist2[i]);
-    }
-    return distance;
+    return histogramIntersection(hist1.data(), hist2.data(), std::min(hist1.size(), hist2.size()));
 }
 
-// Extract features from images in a directory and save them to a CSV file
-void extractFeaturesAndSave(const std::string& inputDir, const std::string& outputFile) {
-    std::vector<ImageFeatures> featuresList;
-
-    // Iterate over images in the input directory
-    for (const auto& entry : fs::directory_iterator(inputDir)) {
-        if (entry.path().extension() == ".jpg" || entry.path().extension() == ".png") {
-            // Read image
-            cv::Mat image = cv::imread(entry.path().string(), cv::IMREAD_COLOR);
-            if (image.empty()) {
-                std::cerr << "Error: Unable to read image at path " << entry.path() << std::endl;
-                continue;
-            }
-
-            // Compute features
-            std::vector<float> featuresTop, featuresBottom;
-            computeFeatures(image, featuresTop, featuresBottom);
-
-            // Extract filename from path
-            std::string filename = entry.path().filename().string();
+// Extract features from images in a directory and stream them to a CSV file and feature store
+void extractFeaturesAndSave(const std::string& inputDir, const std::string& outputFile, const std::string& storeFile, const SpatialLayout& layout,
+                            bool incremental = false, int decodeScale = 1) {
+    std::ofstream csvFile(outputFile);
 
-            // Create ImageFeatures struct and add to list
-            ImageFeatures imgFeatures;
-            imgFeatures.filename = filename;
-            imgFeatures.featuresTop = featuresTop;
-            imgFeatures.featuresBottom = featuresBottom;
-            featuresList.push_back(imgFeatures);
+    // Each worker decodes one image and concatenates the histograms of the layout's regions
+    auto compute = [&layout, decodeScale](const fs::path& path, std::vector<float>& features) {
+        // Read image, optionally downscaled by the JPEG decoder
+        cv::Mat image = cv::imread(path.string(), reducedImreadFlag(true, decodeScale));
+        if (image.empty()) {
+            std::cerr << "Error: Unable to read image at path " << path << std::endl;
+            return false;
         }
-    }
-
-    // Write features to CSV file
-    std::ofstream csvFile(outputFile);
-    csvFile << "filename,";
-    for (size_t i = 0; i < featuresList[0].featuresTop.size(); ++i) {
-        csvFile << "top_feature_" << i << ",";
-    }
-    for (size_t i = 0; i < featuresList[0].featuresBottom.size(); ++i) {
-        csvFile << "bottom_feature_" << i << ",";
-    }
-    csvFile << "\n";
 
-    for (const auto& row : featuresList) {
-        csvFile << row.filename << ",";
-        for (const auto& feature : row.featuresTop) {
-            csvFile << feature << ",";
+        // Compute features
+        if (!computeLayoutHistograms(image, layout, features)) {
+            std::cerr << "Error: Image must have 3 channels (BGR)." << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    // Rows are written in directory order as soon as they are ready
+    bool headerWritten = false;
+    auto write = [&](const std::string& filename, const std::vector<float>& features) {
+        if (!headerWritten) {
+            // Regions are named top/bottom for the default layout and region0, region1, ... otherwise
+            size_t regions = layoutRegions(layout, cv::Size(1, 1)).size();
+            size_t bins = features.size() / regions;
+            bool topBottom = layout.spec == DEFAULT_SPATIAL_LAYOUT;
+            csvFile << "filename,";
+            for (size_t r = 0; r < regions; ++r) {
+                std::string prefix = topBottom ? (r == 0 ? "top" : "bottom") : "region" + std::to_string(r);
+                for (size_t i = 0; i < bins; ++i) {
+                    csvFile << prefix << "_feature_" << i << ",";
+                }
+            }
+            csvFile << "\n";
+            headerWritten = true;
         }
-        for (const auto& feature : row.featuresBottom) {
+
+        csvFile << filename << ",";
+        for (const auto& feature : features) {
             csvFile << feature << ",";
         }
         csvFile << "\n";
+    };
+
+    // With a store, unchanged images are copied from the previous store when incremental is set
+    if (storeFile.empty()) {
+        runIngestPipeline(inputDir, compute, write);
+    } else {
+        runStoreIngest(inputDir, storeFile, layoutFeatureType(layout), FS_NORM_MINMAX, compute, write, incremental, decodeScale);
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --incremental only extracts images that are new or changed since the last run,
+    // --scale 2|4|8 computes the histograms from a reduced-resolution decode,
+    // --layout <spec> selects the regions (default 1x2, the top and bottom halves)
+    bool incremental = false;
+    int decodeScale = 1;
+    std::string layoutSpec = DEFAULT_SPATIAL_LAYOUT;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--incremental") {
+            incremental = true;
+        } else if (arg == "--scale" && i + 1 < argc) {
+            decodeScale = std::atoi(argv[++i]);
+        } else if (arg == "--layout" && i + 1 < argc) {
+            layoutSpec = argv[++i];
+        }
+    }
+    if (reducedImreadFlag(true, decodeScale) < 0) {
+        std::cerr << "Error: --scale must be 1, 2, 4 or 8" << std::endl;
+        return 1;
+    }
+    SpatialLayout layout;
+    if (parseSpatialLayout(layoutSpec, layout) != 0) {
+        return 1;
+    }
+
     // Input directory containing images
     std::string inputDirectory = "../olympus";
 
-    // Output CSV file to save features
-    std::string outputFeatureFile = "../feature_multi.csv";
+    // Output CSV file to save features; layouts other than the default get their own files
+    std::string outputFeatureFile = "../feature_multi" + layoutFileSuffix(layout) + ".csv";
+
+    // Binary feature store written alongside the CSV file
+    std::string outputStoreFile = "../feature_multi" + layoutFileSuffix(layout) + ".bin";
 
-    // Extract features from images and save to CSV file
-    extractFeaturesAndSave(inputDirectory, outputFeatureFile);
+    // Extract features from images and save to CSV file and feature store
+    extractFeaturesAndSave(inputDirectory, outputFeatureFile, outputStoreFile, layout, incremental, decodeScale);
 
     return 0;
 }
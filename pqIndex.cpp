@@ -0,0 +1,193 @@
+/**
+
+pqIndex.cpp
+Project 2
+
+Implementation of the product-quantized embedding index.
+
+**/
+
+#include "pqIndex.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "kmeans.h"
+
+#define PQ_MAGIC "CBIRPQ01"
+
+int PqIndex::build(const FeatureStore& store, int numSubspaces, int maxIterations, size_t trainingSample) {
+    size_t rows = store.size();
+    dim_ = store.dim();
+    if (numSubspaces <= 0 || dim_ % numSubspaces != 0) {
+        std::cerr << "Error: PQ subspaces must divide the dimension " << dim_ << std::endl;
+        return -1;
+    }
+    if (rows == 0) {
+        std::cerr << "Error: PQ needs a non-empty feature store" << std::endl;
+        return -1;
+    }
+
+    numSubspaces_ = numSubspaces;
+    size_t sampleSize = trainingSample > 0 ? std::min(trainingSample, rows) : rows;
+    numCentroids_ = static_cast<int>(std::min<size_t>(PQ_CENTROIDS, rows));
+    sampleSize = std::max(sampleSize, static_cast<size_t>(numCentroids_));
+    uint32_t subDim = dim_ / numSubspaces_;
+
+    // Train one codebook per subspace on the same evenly spaced sample
+    codebooks_.assign(static_cast<size_t>(numSubspaces_) * numCentroids_ * subDim, 0.0f);
+    std::vector<float> slices(sampleSize * subDim);
+    std::vector<int> labels(sampleSize);
+    std::vector<float> means;
+    for (int m = 0; m < numSubspaces_; ++m) {
+        for (size_t i = 0; i < sampleSize; ++i) {
+            const float* slice = store.row(i * rows / sampleSize) + m * subDim;
+            std::copy(slice, slice + subDim, slices.begin() + i * subDim);
+        }
+        if (kmeans(slices.data(), static_cast<int>(sampleSize), static_cast<int>(subDim), means, labels.data(), numCentroids_, maxIterations) != 0) {
+            return -1;
+        }
+        std::copy(means.begin(), means.end(), codebooks_.begin() + static_cast<size_t>(m) * numCentroids_ * subDim);
+    }
+
+    codes_.assign(rows * numSubspaces_, 0);
+    for (size_t i = 0; i < rows; ++i) {
+        encode(store.row(i), &codes_[i * numSubspaces_]);
+    }
+    return 0;
+}
+
+void PqIndex::encode(const float* vector, uint8_t* code) const {
+    uint32_t subDim = dim_ / numSubspaces_;
+    for (int m = 0; m < numSubspaces_; ++m) {
+        const float* slice = vector + m * subDim;
+        const float* codebook = &codebooks_[static_cast<size_t>(m) * numCentroids_ * subDim];
+        float best = ssdDistance(codebook, slice, subDim);
+        int bestCentroid = 0;
+        for (int c = 1; c < numCentroids_; ++c) {
+            float d = ssdDistance(codebook + static_cast<size_t>(c) * subDim, slice, subDim);
+            if (d < best) {
+                best = d;
+                bestCentroid = c;
+            }
+        }
+        code[m] = static_cast<uint8_t>(bestCentroid);
+    }
+}
+
+int PqIndex::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to write PQ index " << path << std::endl;
+        return -1;
+    }
+
+    uint32_t subspaces = numSubspaces_;
+    uint32_t centroids = numCentroids_;
+    uint64_t count = size();
+    file.write(PQ_MAGIC, 8);
+    file.write(reinterpret_cast<const char*>(&dim_), sizeof(dim_));
+    file.write(reinterpret_cast<const char*>(&subspaces), sizeof(subspaces));
+    file.write(reinterpret_cast<const char*>(&centroids), sizeof(centroids));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(codebooks_.data()), codebooks_.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(codes_.data()), codes_.size());
+    return file.good() ? 0 : -1;
+}
+
+int PqIndex::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return -1;
+    }
+    uint64_t fileBytes = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    char magic[8];
+    uint32_t subspaces = 0, centroids = 0;
+    uint64_t count = 0;
+    file.read(magic, 8);
+    file.read(reinterpret_cast<char*>(&dim_), sizeof(dim_));
+    file.read(reinterpret_cast<char*>(&subspaces), sizeof(subspaces));
+    file.read(reinterpret_cast<char*>(&centroids), sizeof(centroids));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, PQ_MAGIC, 8) != 0 || subspaces == 0 || dim_ % subspaces != 0 ||
+        centroids == 0 || centroids > PQ_CENTROIDS) {
+        std::cerr << "Error: " << path << " is not a PQ index" << std::endl;
+        return -1;
+    }
+
+    // The codebooks and codes are sized from the header, so both must exactly fill the file before
+    // anything is allocated; centroids <= PQ_CENTROIDS keeps the codebook size from overflowing
+    uint64_t payloadBytes = fileBytes - (8 + sizeof(dim_) + sizeof(subspaces) + sizeof(centroids) + sizeof(count));
+    uint64_t codebookBytes = static_cast<uint64_t>(centroids) * dim_ * sizeof(float);
+    if (payloadBytes < codebookBytes || count > (payloadBytes - codebookBytes) / subspaces ||
+        count * subspaces != payloadBytes - codebookBytes) {
+        std::cerr << "Error: PQ index " << path << " is truncated or corrupt" << std::endl;
+        codes_.clear();
+        return -1;
+    }
+
+    numSubspaces_ = static_cast<int>(subspaces);
+    numCentroids_ = static_cast<int>(centroids);
+    codebooks_.resize(static_cast<size_t>(centroids) * dim_);
+    codes_.resize(count * subspaces);
+    file.read(reinterpret_cast<char*>(codebooks_.data()), codebooks_.size() * sizeof(float));
+    file.read(reinterpret_cast<char*>(codes_.data()), codes_.size());
+    if (!file) {
+        std::cerr << "Error: PQ index " << path << " is truncated" << std::endl;
+        codes_.clear();
+        return -1;
+    }
+
+    // search() indexes the lookup tables with the codes, so each must name a trained centroid
+    for (uint8_t code : codes_) {
+        if (code >= numCentroids_) {
+            std::cerr << "Error: PQ index " << path << " holds a code beyond its " << numCentroids_ << " centroids" << std::endl;
+            codes_.clear();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void PqIndex::search(const float* query, TopK& result, long excludeId, int rerank, const FeatureStore* store) const {
+    uint32_t subDim = dim_ / numSubspaces_;
+
+    // Lookup tables: dot product of each query slice with every centroid of its subspace
+    std::vector<float> tables(static_cast<size_t>(numSubspaces_) * numCentroids_);
+    for (int m = 0; m < numSubspaces_; ++m) {
+        const float* slice = query + m * subDim;
+        const float* codebook = &codebooks_[static_cast<size_t>(m) * numCentroids_ * subDim];
+        for (int c = 0; c < numCentroids_; ++c) {
+            tables[static_cast<size_t>(m) * numCentroids_ + c] = dotProduct(slice, codebook + static_cast<size_t>(c) * subDim, subDim);
+        }
+    }
+
+    bool exact = rerank > 0 && store != nullptr;
+    TopK shortlist(exact ? std::max(static_cast<size_t>(rerank), result.k()) : 0, true);
+    TopK& scan = exact ? shortlist : result;
+
+    size_t count = size();
+    const uint8_t* code = codes_.data();
+    for (size_t i = 0; i < count; ++i, code += numSubspaces_) {
+        if (static_cast<long>(i) == excludeId) {
+            continue;
+        }
+        const float* table = tables.data();
+        float score = 0.0f;
+        for (int m = 0; m < numSubspaces_; ++m, table += numCentroids_) {
+            score += table[code[m]];
+        }
+        scan.push(static_cast<uint32_t>(i), score);
+    }
+
+    if (exact) {
+        for (const auto& candidate : shortlist.sorted()) {
+            result.push(candidate.id, dotProduct(query, store->row(candidate.id), dim_));
+        }
+    }
+}
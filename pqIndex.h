@@ -0,0 +1,56 @@
+/**
+
+pqIndex.h
+Project 2
+
+Product-quantized storage for the ResNet18 embeddings. Each vector is split into
+numSubspaces equal slices and every slice is replaced by the index of its nearest
+centroid in a 256-entry sub-codebook trained with kmeans(), so a 512-float
+embedding shrinks to numSubspaces bytes. A query builds one lookup table of
+slice-to-centroid dot products per subspace and scores every code with
+numSubspaces table reads (asymmetric distance). An optional re-rank rescores the
+best candidates against the full-precision vectors of the store.
+
+**/
+#ifndef PQINDEX_H
+#define PQINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "featureStore.h"
+#include "topK.h"
+
+#define PQ_CENTROIDS 256
+
+class PqIndex {
+public:
+    // Train the sub-codebooks on an L2-normalized store and encode every row.
+    // dim must be divisible by numSubspaces; trainingSample = 0 trains on every row.
+    int build(const FeatureStore& store, int numSubspaces, int maxIterations = 10, size_t trainingSample = 0);
+
+    // Index files hold the codebooks and the codes; the store is not needed to search
+    int save(const std::string& path) const;
+    int load(const std::string& path);
+
+    // Cosine similarity search of a unit-length query over the codes. Scores are
+    // approximate dot products (larger is better). With rerank > 0 and a store, the best
+    // rerank candidates are rescored exactly. excludeId is skipped, -1 skips nothing.
+    void search(const float* query, TopK& result, long excludeId = -1, int rerank = 0, const FeatureStore* store = nullptr) const;
+
+    int numSubspaces() const { return numSubspaces_; }
+    size_t size() const { return numSubspaces_ > 0 ? codes_.size() / numSubspaces_ : 0; }
+    uint32_t dim() const { return dim_; }
+    size_t codeBytes() const { return codes_.size(); }
+
+private:
+    void encode(const float* vector, uint8_t* code) const;
+
+    uint32_t dim_ = 0;
+    int numSubspaces_ = 0;
+    int numCentroids_ = 0;
+    std::vector<float> codebooks_; // numSubspaces x numCentroids x (dim / numSubspaces)
+    std::vector<uint8_t> codes_;   // size x numSubspaces centroid indices
+};
+
+#endif
@@ -0,0 +1,208 @@
+/**
+
+prunedScan.cpp
+Project 2
+
+Bounded-kernel scans and the variance-ordered store copy.
+
+**/
+
+#include "prunedScan.h"
+#include "distanceKernels.h"
+#include "quantizedStore.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace fs = std::filesystem;
+
+int parseScanMode(const std::string& name, ScanMode& mode) {
+    if (name == "exact") {
+        mode = SCAN_EXACT;
+    } else if (name == "pruned") {
+        mode = SCAN_PRUNED;
+    } else if (name == "variance") {
+        mode = SCAN_VARIANCE_ORDERED;
+    } else if (name == "uint8") {
+        mode = SCAN_UINT8;
+    } else if (name == "fp16") {
+        mode = SCAN_FLOAT16;
+    } else {
+        std::cerr << "Error: Unknown scan mode " << name << ", expected exact, pruned, variance, uint8 or fp16" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Dimensions of store sorted by decreasing variance over its rows
+static std::vector<uint32_t> varianceOrder(const FeatureStore& store) {
+    size_t dim = store.dim();
+    std::vector<double> sum(dim, 0.0), sumSquares(dim, 0.0);
+    for (size_t i = 0; i < store.size(); ++i) {
+        const float* row = store.row(i);
+        for (size_t d = 0; d < dim; ++d) {
+            sum[d] += row[d];
+            sumSquares[d] += static_cast<double>(row[d]) * row[d];
+        }
+    }
+    std::vector<double> variance(dim, 0.0);
+    for (size_t d = 0; d < dim && store.size() > 0; ++d) {
+        double mean = sum[d] / store.size();
+        variance[d] = sumSquares[d] / store.size() - mean * mean;
+    }
+
+    std::vector<uint32_t> order(dim);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return variance[a] > variance[b]; });
+    return order;
+}
+
+static int writeVarianceOrderedStore(const FeatureStore& store, const std::string& orderedFile, const std::vector<uint32_t>& order) {
+    std::ofstream dims(orderedFile + ".dims", std::ios::trunc);
+    for (uint32_t d : order) {
+        dims << d << "\n";
+    }
+    dims.close();
+    if (!dims) {
+        std::cerr << "Error: Unable to write " << orderedFile << ".dims" << std::endl;
+        return -1;
+    }
+
+    FeatureStoreWriter writer;
+    if (writer.open(orderedFile, store.featureType(), store.normalization(), store.dim()) != 0) {
+        return -1;
+    }
+    writer.setDecodeScale(store.decodeScale());
+    std::vector<float> permuted(store.dim());
+    for (size_t i = 0; i < store.size(); ++i) {
+        const float* row = store.row(i);
+        for (size_t j = 0; j < order.size(); ++j) {
+            permuted[j] = row[order[j]];
+        }
+        writer.append(std::string(store.name(i)), permuted);
+    }
+    return writer.close();
+}
+
+static int loadOrder(const std::string& path, size_t dim, std::vector<uint32_t>& order) {
+    order.clear();
+    std::ifstream file(path);
+    uint32_t d;
+    std::vector<bool> seen(dim, false);
+    while (file >> d) {
+        if (d >= dim || seen[d]) {
+            return -1;
+        }
+        seen[d] = true;
+        order.push_back(d);
+    }
+    return order.size() == dim ? 0 : -1;
+}
+
+int VarianceOrderedStore::open(const FeatureStore& store, const std::string& storeFile) {
+    std::string orderedFile = storeFile + ".varorder";
+
+    // The copy is only trusted while it is newer than the store and matches its shape
+    std::error_code ec, orderedEc;
+    auto storeTime = fs::last_write_time(storeFile, ec);
+    auto orderedTime = fs::last_write_time(orderedFile, orderedEc);
+    if (!ec && !orderedEc && orderedTime >= storeTime && ordered_.open(orderedFile) == 0 && ordered_.size() == store.size() &&
+        ordered_.dim() == store.dim() && loadOrder(orderedFile + ".dims", store.dim(), order_) == 0) {
+        return 0;
+    }
+    ordered_.close();
+
+    std::cout << "Writing variance-ordered copy " << orderedFile << std::endl;
+    order_ = varianceOrder(store);
+    if (writeVarianceOrderedStore(store, orderedFile, order_) != 0 || ordered_.open(orderedFile) != 0) {
+        std::cerr << "Error: Unable to write " << orderedFile << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int prunedScan(const FeatureStore& store, const std::string& storeFile, const float* query, PrunedMetric metric, long excludeId,
+               ScanMode mode, TopK& best, ScanStats* stats) {
+    if (best.largerIsBetter()) {
+        std::cerr << "Error: A pruned scan needs a distance ranking" << std::endl;
+        return -1;
+    }
+    const DistanceKernelTable& kernels = distanceKernels();
+    DistanceKernel exact = metric == PRUNED_SSD ? kernels.ssd : kernels.l1;
+    BoundedDistanceKernel bounded = metric == PRUNED_SSD ? kernels.ssdBounded : kernels.l1Bounded;
+    size_t dim = store.dim();
+
+    if (mode == SCAN_UINT8 || mode == SCAN_FLOAT16) {
+        FeatureStore quantized;
+        uint32_t dtype = mode == SCAN_UINT8 ? FS_DTYPE_UINT8 : FS_DTYPE_FLOAT16;
+        if (openQuantizedStore(quantized, store, storeFile, dtype) != 0 ||
+            quantizedScan(quantized, query, metric == PRUNED_SSD ? QUANT_SSD : QUANT_L1, excludeId, best) != 0) {
+            return -1;
+        }
+        if (stats) {
+            size_t candidates = store.size() - (excludeId >= 0 && static_cast<size_t>(excludeId) < store.size() ? 1 : 0);
+            *stats = ScanStats{candidates, candidates * dim, candidates * dim, 0};
+        }
+        return 0;
+    }
+
+    // The scan reads the rows of scanned, with the query permuted the same way
+    VarianceOrderedStore ordered;
+    const FeatureStore* scanned = &store;
+    const float* scannedQuery = query;
+    std::vector<float> permutedQuery;
+    float slack = 1.0f;
+    if (mode == SCAN_VARIANCE_ORDERED) {
+        if (ordered.open(store, storeFile) != 0) {
+            return -1;
+        }
+        scanned = &ordered.store();
+        permutedQuery.resize(dim);
+        for (size_t j = 0; j < dim; ++j) {
+            permutedQuery[j] = query[ordered.order()[j]];
+        }
+        scannedQuery = permutedQuery.data();
+
+        // A sum of dim non-negative terms in another order differs by less than this factor
+        slack = 1.0f + 2.0f * static_cast<float>(dim) * FLT_EPSILON;
+    }
+
+    ScanStats local;
+    for (size_t i = 0; i < store.size(); ++i) {
+        if (static_cast<long>(i) == excludeId) {
+            continue;
+        }
+        ++local.candidates;
+        local.dimsTotal += dim;
+
+        if (mode == SCAN_EXACT) {
+            local.dimsScanned += dim;
+            best.push(static_cast<uint32_t>(i), exact(query, store.row(i), dim));
+            continue;
+        }
+
+        // A distance above the k-th best could not enter the result anyway
+        float bound = best.threshold() * slack;
+        size_t read = 0;
+        float distance = bounded(scannedQuery, scanned->row(i), dim, bound, &read);
+        local.dimsScanned += read;
+        if (distance > bound) {
+            ++local.abandoned;
+            continue;
+        }
+        if (mode == SCAN_VARIANCE_ORDERED) {
+            // Rescore on the stored order so the pushed distance is the exact one
+            distance = exact(query, store.row(i), dim);
+            local.dimsScanned += dim;
+        }
+        best.push(static_cast<uint32_t>(i), distance);
+    }
+    if (stats) {
+        *stats = local;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+/**
+
+prunedScan.h
+Project 2
+
+Early-abandon nearest-neighbor scans for the SSD and L1 matchers. Every candidate's
+distance is computed with a bounded kernel whose bound is the current k-th best
+distance, so most candidates stop after the first few blocks of dimensions once the
+top-k has filled with good matches. The result is identical to the exact scan.
+
+The scan abandons sooner when the dimensions that differ most between images come
+first. The variance-ordered mode scans a copy of the store whose dimensions are
+sorted by decreasing variance over the collection (<storeFile>.varorder, rebuilt when
+the store is newer). The permuted sums round differently, so candidates that survive
+the bound are rescored on the original rows and the bound is loosened by the worst
+case rounding error of the sum, which keeps the results identical here too.
+
+The uint8 and fp16 modes trade exactness for bandwidth: they scan the quantized copy
+of the store (see quantizedStore.h) without pruning.
+
+**/
+#ifndef PRUNEDSCAN_H
+#define PRUNEDSCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "featureStore.h"
+#include "topK.h"
+
+enum ScanMode {
+    SCAN_EXACT,            // every distance in full
+    SCAN_PRUNED,           // early abandon in stored dimension order
+    SCAN_VARIANCE_ORDERED, // early abandon over the variance-ordered copy
+    SCAN_UINT8,            // full scan of the uint8 copy, approximate
+    SCAN_FLOAT16           // full scan of the float16 copy, approximate
+};
+
+enum PrunedMetric {
+    PRUNED_SSD,
+    PRUNED_L1
+};
+
+// Work done by a scan, to compare the modes
+struct ScanStats {
+    size_t candidates = 0;
+    size_t dimsScanned = 0;
+    size_t dimsTotal = 0;
+    size_t abandoned = 0;
+};
+
+// Parse exact, pruned, variance, uint8 or fp16; returns -1 (and prints the error) otherwise
+int parseScanMode(const std::string& name, ScanMode& mode);
+
+// A store's dimensions sorted by decreasing variance, and the rows permuted to match
+class VarianceOrderedStore {
+public:
+    // Open <storeFile>.varorder for store, building it first if it is missing or older than storeFile
+    int open(const FeatureStore& store, const std::string& storeFile);
+
+    const FeatureStore& store() const { return ordered_; }
+    const std::vector<uint32_t>& order() const { return order_; } // order_[j] is the original dimension at position j
+
+private:
+    FeatureStore ordered_;
+    std::vector<uint32_t> order_;
+};
+
+// Push every row of store except excludeId (-1 for none) into best under metric, which
+// must be a distance TopK. mode selects the pruning (SCAN_EXACT computes everything).
+// storeFile locates the variance-ordered and quantized copies. Returns -1 on error.
+int prunedScan(const FeatureStore& store, const std::string& storeFile, const float* query, PrunedMetric metric, long excludeId,
+               ScanMode mode, TopK& best, ScanStats* stats = nullptr);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+
+quantizationReport.cpp
+Project 2
+
+Accuracy report for the quantized store copies. Ranks the collection for a set of
+query images with the float store and with its uint8 and float16 copies, then reports
+bytes per row, scan time, how much of the float top-k each copy keeps and how far the
+quantized distances of the float top-k are from the float ones. Use it to decide
+whether a feature family can be matched in uint8 or fp16 without losing matches.
+
+Usage: quantizationReport <storeFile> <ssd|l1|intersection> [k] [numQueries]
+
+**/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "distanceKernels.h"
+#include "featureStore.h"
+#include "quantizedStore.h"
+#include "topK.h"
+
+// Rankings of one representation over all queries
+struct QueryRankings {
+    std::vector<std::vector<TopKEntry>> matches;
+    double msPerQuery = 0.0;
+};
+
+static float floatDistance(QuantizedMetric metric, const float* a, const float* b, size_t n) {
+    switch (metric) {
+    case QUANT_SSD:
+        return ssdDistance(a, b, n);
+    case QUANT_L1:
+        return l1Distance(a, b, n);
+    default:
+        return histogramIntersection(a, b, n);
+    }
+}
+
+// Distance between query row q and row i of a quantized copy
+static float quantizedDistance(const FeatureStore& quantized, const FeatureStore& store, QuantizedMetric metric, size_t q, size_t i) {
+    if (quantized.dtype() == FS_DTYPE_FLOAT16) {
+        return float16Distance(metric, store.row(q), quantized.halfRow(i), store.dim());
+    }
+    return uint8Distance(metric, quantized.codes(q), quantized.rowScale(q), quantized.codes(i), quantized.rowScale(i), store.dim());
+}
+
+static int rankQueries(const FeatureStore& store, const FeatureStore* quantized, QuantizedMetric metric, const std::vector<size_t>& queries,
+                       int k, QueryRankings& result) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t q : queries) {
+        TopK best(k, metric == QUANT_INTERSECTION);
+        if (quantized) {
+            if (quantizedScan(*quantized, store.row(q), metric, static_cast<long>(q), best) != 0) {
+                return -1;
+            }
+        } else {
+            for (size_t i = 0; i < store.size(); ++i) {
+                if (i != q) {
+                    best.push(static_cast<uint32_t>(i), floatDistance(metric, store.row(q), store.row(i), store.dim()));
+                }
+            }
+        }
+        result.matches.push_back(best.sorted());
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.msPerQuery = ms / queries.size();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <storeFile> <ssd|l1|intersection> [k] [numQueries]" << std::endl;
+        return 1;
+    }
+    std::string storeFile = argv[1];
+    std::string metricName = argv[2];
+    int k = argc > 3 ? std::atoi(argv[3]) : 5;
+    int numQueries = argc > 4 ? std::atoi(argv[4]) : 100;
+
+    QuantizedMetric metric;
+    if (metricName == "ssd") {
+        metric = QUANT_SSD;
+    } else if (metricName == "l1") {
+        metric = QUANT_L1;
+    } else if (metricName == "intersection") {
+        metric = QUANT_INTERSECTION;
+    } else {
+        std::cerr << "Error: Unknown metric " << metricName << ", expected ssd, l1 or intersection" << std::endl;
+        return 1;
+    }
+
+    FeatureStore store;
+    if (store.open(storeFile) != 0 || store.size() < 2 || store.dtype() != FS_DTYPE_FLOAT32) {
+        std::cerr << "Error: " << storeFile << " is not a float feature store with at least two images" << std::endl;
+        return 1;
+    }
+    size_t count = store.size();
+    numQueries = std::max(1, std::min(numQueries, static_cast<int>(count)));
+    k = std::max(1, std::min(k, static_cast<int>(count) - 1));
+
+    std::vector<size_t> queries;
+    for (int q = 0; q < numQueries; ++q) {
+        queries.push_back(static_cast<size_t>(q) * count / numQueries);
+    }
+    QueryRankings reference;
+    if (rankQueries(store, nullptr, metric, queries, k, reference) != 0) {
+        return 1;
+    }
+
+    std::cout << store.featureType() << ", " << count << " images, " << store.dim() << " dims, " << numQueries << " queries, metric "
+              << metricName << ", kernels " << (quantizedKernels().level == SIMD_SCALAR ? "scalar" : "avx2") << "\n";
+    std::cout << "dtype    bytes/row  ms/query  speedup  overlap@" << k << "  top-1 agreement  mean rel. error\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "float32  " << std::setw(9) << store.rowStride() << "  " << std::setw(8) << reference.msPerQuery
+              << "  1.000    1.000      1.000            0.000\n";
+
+    for (uint32_t dtype : {FS_DTYPE_UINT8, FS_DTYPE_FLOAT16}) {
+        FeatureStore quantized;
+        if (openQuantizedStore(quantized, store, storeFile, dtype) != 0) {
+            continue; // e.g. uint8 of a store with negative values
+        }
+        QueryRankings rankings;
+        if (rankQueries(store, &quantized, metric, queries, k, rankings) != 0) {
+            return 1;
+        }
+
+        // Overlap of the id sets, and the error of the quantized distance on the float top-k
+        size_t found = 0, expected = 0, topAgree = 0, errors = 0;
+        double relativeError = 0.0;
+        for (size_t q = 0; q < queries.size(); ++q) {
+            const std::vector<TopKEntry>& exact = reference.matches[q];
+            const std::vector<TopKEntry>& approximate = rankings.matches[q];
+            for (const TopKEntry& match : exact) {
+                ++expected;
+                for (const TopKEntry& candidate : approximate) {
+                    if (candidate.id == match.id) {
+                        ++found;
+                        break;
+                    }
+                }
+                if (match.score != 0.0f) {
+                    float distance = quantizedDistance(quantized, store, metric, queries[q], match.id);
+                    relativeError += std::fabs(distance - match.score) / std::fabs(match.score);
+                    ++errors;
+                }
+            }
+            if (!exact.empty() && !approximate.empty() && exact[0].id == approximate[0].id) {
+                ++topAgree;
+            }
+        }
+
+        std::cout << (dtype == FS_DTYPE_UINT8 ? "uint8    " : "fp16     ") << std::setw(9) << quantized.rowStride() << "  " << std::setw(8)
+                  << rankings.msPerQuery << "  " << std::setw(5) << reference.msPerQuery / rankings.msPerQuery << "    "
+                  << static_cast<double>(found) / expected << "      " << static_cast<double>(topAgree) / queries.size() << "            "
+                  << (errors ? relativeError / errors : 0.0) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,402 @@
+/**
+
+quantizedKernels.h
+Project 2
+
+Conversions and distance kernels for the quantized feature store dtypes.
+
+uint8 rows hold round(v / scale) for a per-row scale of max(v) / 255, so they suit
+non-negative features such as histograms. Two rows with the same scale (every
+min-max normalized histogram has max 1) are compared in integer arithmetic: L1 with
+vpsadbw, intersection with vpminub followed by vpsadbw, SSD with 16-bit differences
+and vpmaddwd. The integer sums are exact, so the only error is the quantization
+itself. Rows with different scales are dequantized on the fly.
+
+float16 rows are IEEE half precision and are compared against a float query after
+conversion with F16C.
+
+Each kernel has an AVX2 and a scalar implementation, chosen once like the kernels
+in distanceKernels.h (the AVX2 ones also serve AVX-512 CPUs).
+
+**/
+#ifndef QUANTIZEDKERNELS_H
+#define QUANTIZEDKERNELS_H
+
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "distanceKernels.h"
+
+#ifdef CBIR_X86_SIMD
+#include <cpuid.h>
+#define CBIR_TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#endif
+
+enum QuantizedMetric {
+    QUANT_SSD,
+    QUANT_L1,
+    QUANT_INTERSECTION // a similarity, larger is better
+};
+
+// IEEE half precision, rounding to nearest even
+inline uint16_t floatToHalf(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+    if (x >= 0x7f800000) {
+        return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0); // infinity or NaN
+    }
+    if (x >= 0x477ff000) {
+        return sign | 0x7c00; // rounds above the largest half
+    }
+    if (x < 0x38800000) {
+        // Subnormal half: adding 0.5 leaves the value in units of 2^-24 in the low bits
+        float magnitude;
+        std::memcpy(&magnitude, &x, sizeof(x));
+        magnitude += 0.5f;
+        std::memcpy(&x, &magnitude, sizeof(x));
+        return sign | static_cast<uint16_t>(x - 0x3f000000);
+    }
+    uint32_t odd = (x >> 13) & 1;
+    x += 0xc8000fff + odd; // rebias the exponent and round the dropped bits
+    return sign | static_cast<uint16_t>(x >> 13);
+}
+
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0) {
+        float magnitude = mantissa * 5.9604644775390625e-8f; // 2^-24
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Quantize n non-negative values to codes; returns the row scale (0 for an all-zero row).
+// Negative values are stored as 0.
+inline float quantizeUint8(const float* values, size_t n, uint8_t* codes) {
+    float maxValue = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        maxValue = values[i] > maxValue ? values[i] : maxValue;
+    }
+    float scale = maxValue / 255.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float code = scale > 0.0f && values[i] > 0.0f ? std::nearbyint(values[i] / scale) : 0.0f;
+        codes[i] = static_cast<uint8_t>(code > 255.0f ? 255.0f : code);
+    }
+    return scale;
+}
+
+typedef uint64_t (*Uint8SumKernel)(const uint8_t* a, const uint8_t* b, size_t n);
+typedef float (*Uint8MixedKernel)(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n);
+typedef float (*Float16Kernel)(const float* a, const uint16_t* b, size_t n);
+
+struct QuantizedKernelTable {
+    SimdLevel level;
+    Uint8SumKernel sad;      // sum of |a - b| over codes
+    Uint8SumKernel minSum;   // sum of min(a, b)
+    Uint8SumKernel ssd;      // sum of (a - b)^2
+    Uint8MixedKernel l1Mixed;
+    Uint8MixedKernel ssdMixed;
+    Uint8MixedKernel intersectionMixed;
+    Float16Kernel l1Half;
+    Float16Kernel ssdHalf;
+    Float16Kernel intersectionHalf;
+};
+
+namespace quantized_scalar {
+
+inline uint64_t sad(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += static_cast<uint64_t>(std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+    }
+    return sum;
+}
+
+inline uint64_t minSum(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += a[i] < b[i] ? a[i] : b[i];
+    }
+    return sum;
+}
+
+inline uint64_t ssd(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        sum += static_cast<uint64_t>(d * d);
+    }
+    return sum;
+}
+
+inline float l1Mixed(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += std::fabs(a[i] * scaleA - b[i] * scaleB);
+    }
+    return sum;
+}
+
+inline float ssdMixed(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float d = a[i] * scaleA - b[i] * scaleB;
+        sum += d * d;
+    }
+    return sum;
+}
+
+inline float intersectionMixed(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float va = a[i] * scaleA, vb = b[i] * scaleB;
+        sum += va < vb ? va : vb;
+    }
+    return sum;
+}
+
+inline float l1Half(const float* a, const uint16_t* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += std::fabs(a[i] - halfToFloat(b[i]));
+    }
+    return sum;
+}
+
+inline float ssdHalf(const float* a, const uint16_t* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float d = a[i] - halfToFloat(b[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+inline float intersectionHalf(const float* a, const uint16_t* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float vb = halfToFloat(b[i]);
+        sum += a[i] < vb ? a[i] : vb;
+    }
+    return sum;
+}
+
+} // namespace quantized_scalar
+
+#ifdef CBIR_X86_SIMD
+
+namespace quantized_avx2 {
+
+CBIR_TARGET_AVX2 inline uint64_t hsum64(__m256i v) {
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(sum)) + static_cast<uint64_t>(_mm_extract_epi64(sum, 1));
+}
+
+CBIR_TARGET_AVX2 inline __m256i load32(const uint8_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+// 32 codes per step; vpsadbw sums the absolute differences of each 8 bytes into a 64-bit lane
+CBIR_TARGET_AVX2 inline uint64_t sad(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(load32(a + i), load32(b + i)));
+    }
+    return hsum64(acc) + quantized_scalar::sad(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline uint64_t minSum(const uint8_t* a, const uint8_t* b, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_min_epu8(load32(a + i), load32(b + i)), zero));
+    }
+    return hsum64(acc) + quantized_scalar::minSum(a + i, b + i, n - i);
+}
+
+// Differences are widened to 16 bits and squared and paired by vpmaddwd. A 32-bit lane
+// gains at most 4 * 255^2 per step, so the lanes are flushed to 64 bits every 4096 steps.
+CBIR_TARGET_AVX2 inline uint64_t ssd(const uint8_t* a, const uint8_t* b, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 32 <= n) {
+        __m256i acc = _mm256_setzero_si256();
+        size_t blockEnd = i + 32 * 4096 < n ? i + 32 * 4096 : n;
+        for (; i + 32 <= blockEnd; i += 32) {
+            __m256i va = load32(a + i), vb = load32(b + i);
+            __m256i lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero));
+            __m256i hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(lo, lo));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(hi, hi));
+        }
+        total = _mm256_add_epi64(total, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(acc)));
+        total = _mm256_add_epi64(total, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(acc, 1)));
+    }
+    return hsum64(total) + quantized_scalar::ssd(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2 inline __m256 dequantize8(const uint8_t* p, __m256 scale) {
+    __m128i codes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(codes)), scale);
+}
+
+CBIR_TARGET_AVX2 inline float l1Mixed(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 sa = _mm256_set1_ps(scaleA), sb = _mm256_set1_ps(scaleB);
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(dequantize8(a + i, sa), dequantize8(b + i, sb));
+        acc = _mm256_add_ps(acc, _mm256_andnot_ps(signMask, d));
+    }
+    return kernels_avx2::hsum(acc) + quantized_scalar::l1Mixed(a + i, scaleA, b + i, scaleB, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float ssdMixed(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    const __m256 sa = _mm256_set1_ps(scaleA), sb = _mm256_set1_ps(scaleB);
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(dequantize8(a + i, sa), dequantize8(b + i, sb));
+        acc = _mm256_fmadd_ps(d, d, acc);
+    }
+    return kernels_avx2::hsum(acc) + quantized_scalar::ssdMixed(a + i, scaleA, b + i, scaleB, n - i);
+}
+
+CBIR_TARGET_AVX2 inline float intersectionMixed(const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    const __m256 sa = _mm256_set1_ps(scaleA), sb = _mm256_set1_ps(scaleB);
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_min_ps(dequantize8(a + i, sa), dequantize8(b + i, sb)));
+    }
+    return kernels_avx2::hsum(acc) + quantized_scalar::intersectionMixed(a + i, scaleA, b + i, scaleB, n - i);
+}
+
+CBIR_TARGET_AVX2_F16C inline __m256 loadHalf8(const uint16_t* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+CBIR_TARGET_AVX2_F16C inline float l1Half(const float* a, const uint16_t* b, size_t n) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), loadHalf8(b + i));
+        acc = _mm256_add_ps(acc, _mm256_andnot_ps(signMask, d));
+    }
+    return kernels_avx2::hsum(acc) + quantized_scalar::l1Half(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2_F16C inline float ssdHalf(const float* a, const uint16_t* b, size_t n) {
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), loadHalf8(b + i));
+        acc = _mm256_fmadd_ps(d, d, acc);
+    }
+    return kernels_avx2::hsum(acc) + quantized_scalar::ssdHalf(a + i, b + i, n - i);
+}
+
+CBIR_TARGET_AVX2_F16C inline float intersectionHalf(const float* a, const uint16_t* b, size_t n) {
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_min_ps(_mm256_loadu_ps(a + i), loadHalf8(b + i)));
+    }
+    return kernels_avx2::hsum(acc) + quantized_scalar::intersectionHalf(a + i, b + i, n - i);
+}
+
+} // namespace quantized_avx2
+
+#endif // CBIR_X86_SIMD
+
+// Kernel table for the current CPU, resolved on first use
+inline const QuantizedKernelTable& quantizedKernels() {
+    static const QuantizedKernelTable table = [] {
+#ifdef CBIR_X86_SIMD
+        unsigned eax, ebx, ecx, edx;
+        bool f16c = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_F16C);
+        if (detectSimdLevel() >= SIMD_AVX2 && f16c) {
+            return QuantizedKernelTable{SIMD_AVX2,
+                                        quantized_avx2::sad,
+                                        quantized_avx2::minSum,
+                                        quantized_avx2::ssd,
+                                        quantized_avx2::l1Mixed,
+                                        quantized_avx2::ssdMixed,
+                                        quantized_avx2::intersectionMixed,
+                                        quantized_avx2::l1Half,
+                                        quantized_avx2::ssdHalf,
+                                        quantized_avx2::intersectionHalf};
+        }
+#endif
+        return QuantizedKernelTable{SIMD_SCALAR,
+                                    quantized_scalar::sad,
+                                    quantized_scalar::minSum,
+                                    quantized_scalar::ssd,
+                                    quantized_scalar::l1Mixed,
+                                    quantized_scalar::ssdMixed,
+                                    quantized_scalar::intersectionMixed,
+                                    quantized_scalar::l1Half,
+                                    quantized_scalar::ssdHalf,
+                                    quantized_scalar::intersectionHalf};
+    }();
+    return table;
+}
+
+// Distance between two uint8 rows with their scales, in the units of the original values
+inline float uint8Distance(QuantizedMetric metric, const uint8_t* a, float scaleA, const uint8_t* b, float scaleB, size_t n) {
+    const QuantizedKernelTable& kernels = quantizedKernels();
+    if (scaleA == scaleB) {
+        switch (metric) {
+        case QUANT_SSD:
+            return scaleA * scaleA * static_cast<float>(kernels.ssd(a, b, n));
+        case QUANT_L1:
+            return scaleA * static_cast<float>(kernels.sad(a, b, n));
+        case QUANT_INTERSECTION:
+            return scaleA * static_cast<float>(kernels.minSum(a, b, n));
+        }
+    }
+    switch (metric) {
+    case QUANT_SSD:
+        return kernels.ssdMixed(a, scaleA, b, scaleB, n);
+    case QUANT_L1:
+        return kernels.l1Mixed(a, scaleA, b, scaleB, n);
+    case QUANT_INTERSECTION:
+        return kernels.intersectionMixed(a, scaleA, b, scaleB, n);
+    }
+    return 0.0f;
+}
+
+// Distance between a float query and a float16 row
+inline float float16Distance(QuantizedMetric metric, const float* a, const uint16_t* b, size_t n) {
+    const QuantizedKernelTable& kernels = quantizedKernels();
+    switch (metric) {
+    case QUANT_SSD:
+        return kernels.ssdHalf(a, b, n);
+    case QUANT_L1:
+        return kernels.l1Half(a, b, n);
+    case QUANT_INTERSECTION:
+        return kernels.intersectionHalf(a, b, n);
+    }
+    return 0.0f;
+}
+
+#endif
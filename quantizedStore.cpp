@@ -0,0 +1,100 @@
+/**
+
+quantizedStore.cpp
+Project 2
+
+Writing, opening and scanning the uint8 and float16 store copies.
+
+**/
+
+#include "quantizedStore.h"
+
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+std::string quantizedStoreFile(const std::string& storeFile, uint32_t dtype) {
+    return storeFile + (dtype == FS_DTYPE_UINT8 ? ".u8" : ".f16");
+}
+
+int writeQuantizedStore(const FeatureStore& store, const std::string& quantizedFile, uint32_t dtype) {
+    if (store.dtype() != FS_DTYPE_FLOAT32 || (dtype != FS_DTYPE_UINT8 && dtype != FS_DTYPE_FLOAT16)) {
+        std::cerr << "Error: Quantized copies are written from float stores to uint8 or float16" << std::endl;
+        return -1;
+    }
+    if (dtype == FS_DTYPE_UINT8) {
+        for (size_t i = 0; i < store.size(); ++i) {
+            const float* row = store.row(i);
+            for (uint32_t j = 0; j < store.dim(); ++j) {
+                if (row[j] < 0.0f) {
+                    std::cerr << "Error: " << store.name(i) << " has negative features, which uint8 cannot hold" << std::endl;
+                    return -1;
+                }
+            }
+        }
+    }
+
+    FeatureStoreWriter writer;
+    if (writer.open(quantizedFile, store.featureType(), store.normalization(), store.dim(), dtype) != 0) {
+        return -1;
+    }
+    writer.setDecodeScale(store.decodeScale());
+    for (size_t i = 0; i < store.size(); ++i) {
+        writer.append(std::string(store.name(i)), store.row(i), store.dim());
+    }
+    return writer.close();
+}
+
+int openQuantizedStore(FeatureStore& quantized, const FeatureStore& store, const std::string& storeFile, uint32_t dtype) {
+    std::string quantizedFile = quantizedStoreFile(storeFile, dtype);
+
+    // The copy is only trusted while it is newer than the store and matches its shape
+    std::error_code ec, quantizedEc;
+    auto storeTime = fs::last_write_time(storeFile, ec);
+    auto quantizedTime = fs::last_write_time(quantizedFile, quantizedEc);
+    if (!ec && !quantizedEc && quantizedTime >= storeTime && quantized.openQuantized(quantizedFile) == 0 && quantized.dtype() == dtype &&
+        quantized.size() == store.size() && quantized.dim() == store.dim()) {
+        return 0;
+    }
+    quantized.close();
+
+    std::cout << "Writing quantized copy " << quantizedFile << std::endl;
+    if (writeQuantizedStore(store, quantizedFile, dtype) != 0 || quantized.openQuantized(quantizedFile) != 0) {
+        std::cerr << "Error: Unable to write " << quantizedFile << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int quantizedScan(const FeatureStore& quantized, const float* query, QuantizedMetric metric, long excludeId, TopK& best) {
+    if (best.largerIsBetter() != (metric == QUANT_INTERSECTION)) {
+        std::cerr << "Error: The TopK ranking does not match the metric" << std::endl;
+        return -1;
+    }
+    size_t dim = quantized.dim();
+
+    if (quantized.dtype() == FS_DTYPE_FLOAT16) {
+        for (size_t i = 0; i < quantized.size(); ++i) {
+            if (static_cast<long>(i) != excludeId) {
+                best.push(static_cast<uint32_t>(i), float16Distance(metric, query, quantized.halfRow(i), dim));
+            }
+        }
+        return 0;
+    }
+    if (quantized.dtype() != FS_DTYPE_UINT8) {
+        std::cerr << "Error: " << quantized.featureType() << " store is not quantized" << std::endl;
+        return -1;
+    }
+
+    std::vector<uint8_t> queryCodes(dim);
+    float queryScale = quantizeUint8(query, dim, queryCodes.data());
+    for (size_t i = 0; i < quantized.size(); ++i) {
+        if (static_cast<long>(i) != excludeId) {
+            float distance = uint8Distance(metric, queryCodes.data(), queryScale, quantized.codes(i), quantized.rowScale(i), dim);
+            best.push(static_cast<uint32_t>(i), distance);
+        }
+    }
+    return 0;
+}
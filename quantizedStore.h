@@ -0,0 +1,40 @@
+/**
+
+quantizedStore.h
+Project 2
+
+Quantized copies of a float feature store. A uint8 copy (<storeFile>.u8) keeps one
+byte per value plus a per-row scale and a float16 copy (<storeFile>.f16) two bytes
+per value, so a scan moves a quarter or half of the bytes of the float store and four
+or two times as many rows fit in cache. Copies are written on first use and rewritten
+whenever the float store is newer.
+
+uint8 needs non-negative features (the histogram families); a store with negative
+values is refused rather than clamped. Use quantizationReport to see what the
+rounding does to the rankings of a store before matching against a copy.
+
+**/
+#ifndef QUANTIZEDSTORE_H
+#define QUANTIZEDSTORE_H
+
+#include <string>
+#include "featureStore.h"
+#include "quantizedKernels.h"
+#include "topK.h"
+
+// Path of the dtype copy of storeFile
+std::string quantizedStoreFile(const std::string& storeFile, uint32_t dtype);
+
+// Write a dtype copy of store to quantizedFile. Returns -1 if a uint8 copy is asked
+// for a store with negative values.
+int writeQuantizedStore(const FeatureStore& store, const std::string& quantizedFile, uint32_t dtype);
+
+// Open the dtype copy of storeFile into quantized, writing it first if it is missing or stale
+int openQuantizedStore(FeatureStore& quantized, const FeatureStore& store, const std::string& storeFile, uint32_t dtype);
+
+// Push every row of quantized except excludeId (-1 for none) into best. query holds the
+// float values; it is quantized the same way for a uint8 store. Distances are in the
+// units of the float store. Returns -1 on error.
+int quantizedScan(const FeatureStore& quantized, const float* query, QuantizedMetric metric, long excludeId, TopK& best);
+
+#endif
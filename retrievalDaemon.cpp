@@ -0,0 +1,470 @@
+/**
+
+retrievalDaemon.cpp
+Project 2
+
+Resident retrieval server. The feature stores, the ResNet18 HNSW index, the face
+cascade and the face index (faceIndex.h) are loaded once at startup and queries
+are answered over a Unix domain socket by a pool of worker threads, so a query
+costs only the feature computation and the scan.
+
+Usage: retrievalDaemon [socketPath] [workers]
+
+Requests are single text lines; a connection may send any number of them:
+  QUERY <featureType> <metric> <k> <filename>   target taken from the store
+  IMAGE <featureType> <metric> <k> <byteCount>  followed by byteCount bytes of an encoded image
+  FACES <byteCount>                             followed by byteCount bytes of an encoded image
+metric is one of ssd, l1, intersection, cosine, hnsw (resnet18 only) or default.
+cosine and hnsw scores are both the angle between the vectors in radians (acos of the
+cosine similarity), so the two can be compared directly; hnsw is approximate.
+Replies are "OK <n>" followed by n lines "<filename> <score>" (or "<x> <y> <width> <height>"
+for FACES), or a single "ERR <message>" line.
+
+**/
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "boundedQueue.h"
+#include "distanceKernels.h"
+#include "faceDetect.h"
+#include "faceDetector.h"
+#include "faceIndex.h"
+#include "featureStore.h"
+#include "hnswIndex.h"
+#include "featureRegistry.h"
+#include "ingestManifest.h"
+#include "topK.h"
+
+// Largest encoded image a client may send
+#define MAX_IMAGE_BYTES (64u << 20)
+
+// Idle connections are dropped after this many seconds so they cannot hold a worker
+#define CLIENT_TIMEOUT_SECONDS 30
+
+// One loaded feature store and the metric used when a request asks for "default"
+struct FeatureFamily {
+    std::string featureType;
+    std::string defaultMetric;
+    FeatureStore store;
+};
+
+struct RetrievalState {
+    std::vector<std::unique_ptr<FeatureFamily>> families;
+    FeatureStore normalizedResnet;
+    HnswIndex resnetIndex;
+    bool hasResnetIndex = false;
+    mutable FaceDetector faceDetector; // thread-safe, lends each busy worker its own classifier
+    mutable FaceIndex faceIndex;       // faces of images seen before, keyed by content hash
+    bool hasFaceIndex = false;
+
+    const FeatureFamily* find(const std::string& featureType) const {
+        for (const auto& family : families) {
+            if (family->featureType == featureType) {
+                return family.get();
+            }
+        }
+        return nullptr;
+    }
+};
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
+// Buffered line and byte reader over a connected socket
+class ClientConnection {
+public:
+    explicit ClientConnection(int fd) : fd_(fd) {}
+
+    bool readLine(std::string& line) {
+        line.clear();
+        while (true) {
+            size_t newline = buffer_.find('\n', start_);
+            if (newline != std::string::npos) {
+                line.assign(buffer_, start_, newline - start_);
+                start_ = newline + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                return true;
+            }
+            if (buffer_.size() - start_ > 4096 || !fill()) {
+                return false;
+            }
+        }
+    }
+
+    bool readBytes(size_t count, std::vector<uchar>& bytes) {
+        bytes.clear();
+        bytes.reserve(count);
+        while (bytes.size() < count) {
+            if (start_ == buffer_.size() && !fill()) {
+                return false;
+            }
+            size_t take = std::min(count - bytes.size(), buffer_.size() - start_);
+            bytes.insert(bytes.end(), buffer_.begin() + start_, buffer_.begin() + start_ + take);
+            start_ += take;
+        }
+        return true;
+    }
+
+    bool writeAll(const std::string& reply) {
+        size_t sent = 0;
+        while (sent < reply.size()) {
+            ssize_t n = send(fd_, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        if (start_ > 0) {
+            buffer_.erase(0, start_);
+            start_ = 0;
+        }
+        char chunk[65536];
+        ssize_t n;
+        do {
+            n = recv(fd_, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, n);
+        return true;
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t start_ = 0;
+};
+
+// Rank every row of family against query, skipping excludeId. Returns false for an unknown metric.
+static bool rankFamily(const RetrievalState& state, const FeatureFamily& family, const float* query, std::string metric,
+                       long excludeId, int k, std::vector<std::pair<std::string, float>>& matches) {
+    const FeatureStore& store = family.store;
+    if (metric == "default") {
+        metric = family.defaultMetric;
+    }
+
+    if (metric == "hnsw") {
+        if (!state.hasResnetIndex || family.featureType != "resnet18") {
+            return false;
+        }
+        std::vector<float> unit(query, query + store.dim());
+        float norm = l2Norm(query, store.dim());
+        for (auto& value : unit) {
+            value = norm > 0.0f ? value / norm : 0.0f;
+        }
+        TopK best(k, true);
+        state.resnetIndex.search(unit.data(), best, excludeId);
+        for (const auto& match : best.sorted()) {
+            float cosine = std::max(-1.0f, std::min(1.0f, match.score));
+            matches.push_back({std::string(state.normalizedResnet.name(match.id)), std::acos(cosine)});
+        }
+        return true;
+    }
+
+    bool similarity = metric == "intersection";
+    if (!similarity && metric != "ssd" && metric != "l1" && metric != "cosine") {
+        return false;
+    }
+
+    TopK best(k, similarity);
+    float queryNorm = metric == "cosine" ? l2Norm(query, store.dim()) : 0.0f;
+    for (size_t i = 0; i < store.size(); ++i) {
+        if (static_cast<long>(i) == excludeId) {
+            continue;
+        }
+        const float* row = store.row(i);
+        float score;
+        if (metric == "ssd") {
+            score = ssdDistance(query, row, store.dim());
+        } else if (metric == "l1") {
+            score = l1Distance(query, row, store.dim());
+        } else if (similarity) {
+            score = histogramIntersection(query, row, store.dim());
+        } else {
+            score = cosineDistance(query, row, store.dim(), queryNorm);
+            if (score < 0.0f) {
+                continue; // zero-length vector
+            }
+        }
+        best.push(static_cast<uint32_t>(i), score);
+    }
+
+    for (const auto& match : best.sorted()) {
+        matches.push_back({std::string(store.name(match.id)), match.score});
+    }
+    return true;
+}
+
+// Answer one request line; returns false if the connection should be closed
+static bool handleRequest(const RetrievalState& state, ClientConnection& client, const std::string& line) {
+    std::istringstream request(line);
+    std::string command;
+    request >> command;
+
+    if (command == "FACES") {
+        size_t byteCount = 0;
+        if (!(request >> byteCount) || byteCount == 0 || byteCount > MAX_IMAGE_BYTES) {
+            return client.writeAll("ERR bad image size\n");
+        }
+        std::vector<uchar> bytes;
+        if (!client.readBytes(byteCount, bytes)) {
+            return false;
+        }
+        if (!state.faceDetector.loaded()) {
+            return client.writeAll("ERR face cascade not loaded\n");
+        }
+
+        // An image the index has seen, in a collection run or an earlier request, is not decoded
+        std::vector<cv::Rect> faces;
+        uint64_t contentHash = hashBytes(bytes.data(), bytes.size());
+        if (!state.faceIndex.lookup(contentHash, bytes.size(), faces)) {
+            cv::Mat grey = cv::imdecode(bytes, cv::IMREAD_GRAYSCALE);
+            if (grey.empty()) {
+                return client.writeAll("ERR unable to decode image\n");
+            }
+            if (state.faceDetector.detect(grey, faces) != 0) {
+                return client.writeAll("ERR face detection failed\n");
+            }
+            state.faceIndex.insert(contentHash, bytes.size(), faces);
+        }
+        std::ostringstream reply;
+        reply << "OK " << faces.size() << "\n";
+        for (const auto& face : faces) {
+            reply << face.x << " " << face.y << " " << face.width << " " << face.height << "\n";
+        }
+        return client.writeAll(reply.str());
+    }
+
+    if (command != "QUERY" && command != "IMAGE") {
+        return client.writeAll("ERR unknown command\n");
+    }
+
+    std::string featureType, metric, target;
+    int k = 0;
+    if (!(request >> featureType >> metric >> k >> target) || k <= 0) {
+        return client.writeAll("ERR expected " + command + " <featureType> <metric> <k> <target>\n");
+    }
+
+    // Image bytes have to be consumed even if the request is rejected below
+    std::vector<uchar> bytes;
+    if (command == "IMAGE") {
+        size_t byteCount = std::strtoul(target.c_str(), nullptr, 10);
+        if (byteCount == 0 || byteCount > MAX_IMAGE_BYTES) {
+            client.writeAll("ERR bad image size\n");
+            return false;
+        }
+        if (!client.readBytes(byteCount, bytes)) {
+            return false;
+        }
+    }
+
+    const FeatureFamily* family = state.find(featureType);
+    if (!family) {
+        return client.writeAll("ERR feature type " + featureType + " is not loaded\n");
+    }
+
+    const float* query = nullptr;
+    long excludeId = -1;
+    std::vector<float> features;
+    if (command == "QUERY") {
+        excludeId = family->store.find(target);
+        if (excludeId < 0) {
+            return client.writeAll("ERR " + target + " is not in the " + featureType + " store\n");
+        }
+        query = family->store.row(excludeId);
+    } else {
+        // Decode at the resolution the stored vectors were computed from
+        int flag = featureImreadFlag(featureType, static_cast<int>(family->store.decodeScale()));
+        if (flag < 0) {
+            return client.writeAll("ERR " + featureType + " cannot be computed from an image\n");
+        }
+        cv::Mat image = cv::imdecode(bytes, flag);
+        if (image.empty() || !computeImageFeatures(featureType, image, features)) {
+            return client.writeAll("ERR unable to compute features\n");
+        }
+        // Pad or truncate to the stored dimension, as the store writer does
+        features.resize(family->store.dim(), 0.0f);
+        query = features.data();
+    }
+
+    std::vector<std::pair<std::string, float>> matches;
+    int limit = static_cast<int>(std::min<size_t>(k, family->store.size()));
+    if (!rankFamily(state, *family, query, metric, excludeId, limit, matches)) {
+        return client.writeAll("ERR metric " + metric + " is not available for " + featureType + "\n");
+    }
+
+    std::ostringstream reply;
+    reply << "OK " << matches.size() << "\n";
+    for (const auto& match : matches) {
+        reply << match.first << " " << match.second << "\n";
+    }
+    return client.writeAll(reply.str());
+}
+
+static void serveClients(const RetrievalState& state, BoundedQueue<int>& clients) {
+    int fd;
+    while (clients.pop(fd)) {
+        ClientConnection client(fd);
+        std::string line;
+        while (client.readLine(line)) {
+            if (!line.empty() && !handleRequest(state, client, line)) {
+                break;
+            }
+        }
+        close(fd);
+    }
+}
+
+// True if both stores hold the same files in the same order, so a row id of one is a row id of the other
+static bool sameCollection(const FeatureStore& a, const FeatureStore& b) {
+    if (a.size() != b.size() || a.dim() != b.dim()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a.name(i) != b.name(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Open a store, importing it from its CSV file if there is one and the store is missing
+static void addFamily(RetrievalState& state, const std::string& featureType, const std::string& defaultMetric,
+                      const std::string& storeFile, const std::string& csvFile, uint32_t normalization) {
+    auto family = std::make_unique<FeatureFamily>();
+    family->featureType = featureType;
+    family->defaultMetric = defaultMetric;
+    int status = csvFile.empty() ? family->store.open(storeFile)
+                                 : loadFeatureStore(family->store, storeFile, csvFile, featureType, normalization);
+    if (status != 0 || family->store.featureType() != featureType) {
+        std::cerr << "Warning: " << featureType << " features are unavailable (" << storeFile << ")" << std::endl;
+        return;
+    }
+
+    std::cout << "Loaded " << family->store.size() << " " << featureType << " vectors from " << storeFile << std::endl;
+    state.families.push_back(std::move(family));
+}
+
+int main(int argc, char* argv[]) {
+    std::string socketPath = argc > 1 ? argv[1] : "/tmp/cbir_retrieval.sock";
+    int workers = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    workers = std::max(1, workers);
+
+    RetrievalState state;
+    addFamily(state, "orb-center", "ssd", "../features.bin", "../features.csv", FS_NORM_NONE);
+    addFamily(state, "rgb-top-bottom", "l1", "../feature_multi.bin", "../feature_multi.csv", FS_NORM_MINMAX);
+    addFamily(state, "hsv-sobel", "l1", "../feature_tc.bin", "../feature_tc.csv", FS_NORM_MINMAX);
+    addFamily(state, "chromaticity-rg", "intersection", "../features_chroma.bin", "", FS_NORM_L1);
+    addFamily(state, "resnet18", "cosine", "/home/rucha/CS5330/Project2/ResNet18_olym.bin",
+              "/home/rucha/CS5330/Project2/ResNet18_olym.csv", FS_NORM_NONE);
+
+    // The HNSW graph written by featureMatching_usingResNet18 --hnsw 16 200 <efSearch>, if present.
+    // Queries exclude the target by its resnet18 row id and name results by graph id, so the
+    // normalized copy must hold the resnet18 store's rows and the graph must have been built
+    // from it; insertStoreRows checks dim and names and adds any rows the graph is missing.
+    const FeatureFamily* resnet = state.find("resnet18");
+    if (resnet && state.normalizedResnet.open("/home/rucha/CS5330/Project2/ResNet18_olym_l2.bin") == 0 &&
+        sameCollection(state.normalizedResnet, resnet->store) &&
+        state.resnetIndex.load("/home/rucha/CS5330/Project2/ResNet18_olym_M16_ef200.hnsw") == 0 &&
+        insertStoreRows(state.resnetIndex, state.normalizedResnet) >= 0) {
+        state.hasResnetIndex = true;
+        std::cout << "Loaded ResNet18 HNSW index" << std::endl;
+    }
+    if (state.families.empty()) {
+        std::cerr << "Error: No feature stores could be loaded" << std::endl;
+        return 1;
+    }
+    if (state.faceDetector.load(FACE_CASCADE_FILE) != 0) {
+        std::cerr << "Warning: FACES requests are disabled" << std::endl;
+    } else if (state.faceIndex.open(FACE_INDEX_FILE, FACE_CASCADE_FILE) == 0) {
+        state.hasFaceIndex = true;
+        std::cout << "Loaded " << state.faceIndex.size() << " indexed face detections" << std::endl;
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (listenFd < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Unable to create socket " << socketPath << std::endl;
+        return 1;
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 64) != 0) {
+        std::cerr << "Error: Unable to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        return 1;
+    }
+
+    // No SA_RESTART, so a stop signal interrupts accept()
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    BoundedQueue<int> clients(static_cast<size_t>(workers) * 4);
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; ++i) {
+        pool.emplace_back(serveClients, std::cref(state), std::ref(clients));
+    }
+    std::cout << "Serving on " << socketPath << " with " << workers << " workers" << std::endl;
+
+    while (!stopRequested) {
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno != EINTR) {
+                std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            }
+            continue;
+        }
+        timeval timeout = {CLIENT_TIMEOUT_SECONDS, 0};
+        setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (!clients.push(clientFd)) {
+            close(clientFd);
+        }
+    }
+
+    std::cout << "Shutting down" << std::endl;
+    clients.close();
+    for (auto& worker : pool) {
+        worker.join();
+    }
+    // Detections made while serving are kept; collection entries no request touched stay too
+    if (state.hasFaceIndex) {
+        state.faceIndex.save(false);
+    }
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return 0;
+}
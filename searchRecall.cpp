@@ -0,0 +1,55 @@
+/**
+
+searchRecall.cpp
+Project 2
+
+Implementation of the recall measurement for the approximate embedding indexes.
+
+**/
+
+#include "searchRecall.h"
+#include "distanceKernels.h"
+
+#include <algorithm>
+#include <chrono>
+
+float measureSearchRecall(const FeatureStore& store, int k, int numQueries, const ApproximateSearch& search, double* meanQueryMs) {
+    size_t rows = store.size();
+    numQueries = std::max(1, std::min(numQueries, static_cast<int>(rows)));
+
+    double totalMs = 0.0;
+    size_t found = 0, expected = 0;
+    for (int q = 0; q < numQueries; ++q) {
+        size_t queryId = static_cast<size_t>(q) * rows / numQueries;
+        const float* query = store.row(queryId);
+
+        // Exact answer by brute force
+        TopK exact(k, true);
+        for (size_t i = 0; i < rows; ++i) {
+            if (i != queryId) {
+                exact.push(static_cast<uint32_t>(i), dotProduct(query, store.row(i), store.dim()));
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        TopK approximate(k, true);
+        search(query, static_cast<long>(queryId), approximate);
+        totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<TopKEntry> approximateResults = approximate.sorted();
+        for (const auto& entry : exact.sorted()) {
+            ++expected;
+            for (const auto& candidate : approximateResults) {
+                if (candidate.id == entry.id) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (meanQueryMs) {
+        *meanQueryMs = totalMs / numQueries;
+    }
+    return expected > 0 ? static_cast<float>(found) / expected : 1.0f;
+}
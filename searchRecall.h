@@ -0,0 +1,25 @@
+/**
+
+searchRecall.h
+Project 2
+
+Recall measurement shared by the approximate embedding indexes (IVF, HNSW, PQ).
+Queries are drawn evenly from an L2-normalized store, answered exactly by a
+brute-force dot-product scan and by the index under test, and the overlap of the
+two top-k lists is averaged.
+
+**/
+#ifndef SEARCHRECALL_H
+#define SEARCHRECALL_H
+
+#include <functional>
+#include "featureStore.h"
+#include "topK.h"
+
+// Runs one approximate query: fill result (larger is better) for query, skipping excludeId
+using ApproximateSearch = std::function<void(const float* query, long excludeId, TopK& result)>;
+
+// Mean recall@k of search over numQueries store rows; meanQueryMs receives the mean search time
+float measureSearchRecall(const FeatureStore& store, int k, int numQueries, const ApproximateSearch& search, double* meanQueryMs = nullptr);
+
+#endif
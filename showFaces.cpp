@@ -33,6 +33,7 @@ int main(int argc, char *argv[]) {
   cv::Mat grey;
   std::vector<cv::Rect> faces;
   cv::Rect last(0, 0, 0, 0);
+  bool detect = true;
 
   // Loop forever
   for(int f=0;;f++) {
@@ -48,8 +49,11 @@ int main(int argc, char *argv[]) {
     // convert the image to greyscale
     cv::cvtColor( frame, grey, cv::COLOR_BGR2GRAY, 0);
 
-    // detect faces
-    detectFaces( grey, faces );
+    // detect faces; without a cascade file keep showing the video rather than retrying every frame
+    if( detect && detectFaces( grey, faces ) != 0 ) {
+      printf("Face detection disabled\n");
+      detect = false;
+    }
 
     // draw boxes around the faces
     drawBoxes( frame, faces );
@@ -0,0 +1,180 @@
+/**
+
+spatialHistogram.cpp
+Project 2
+
+Integral histogram engine and the layout features built on it.
+
+**/
+
+#include "spatialHistogram.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+int parseSpatialLayout(const std::string& spec, SpatialLayout& layout) {
+    layout.spec = spec;
+    layout.grids.clear();
+
+    std::stringstream tokens(spec);
+    std::string token;
+    while (std::getline(tokens, token, ',')) {
+        int cols = 0, rows = 0, levels = 0;
+        char trailing;
+        if (std::sscanf(token.c_str(), "pyramid:%d%c", &levels, &trailing) == 1 && levels >= 1 && levels <= 6) {
+            for (int level = 0; level < levels; ++level) {
+                layout.grids.push_back({1 << level, 1 << level});
+            }
+        } else if (std::sscanf(token.c_str(), "%dx%d%c", &cols, &rows, &trailing) == 2 && cols >= 1 && rows >= 1 && cols <= 64 && rows <= 64) {
+            layout.grids.push_back({cols, rows});
+        } else {
+            std::cerr << "Error: Invalid layout \"" << token << "\", expected CxR or pyramid:N" << std::endl;
+            return -1;
+        }
+    }
+    if (layout.grids.empty()) {
+        std::cerr << "Error: Empty layout" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+std::vector<cv::Rect> layoutRegions(const SpatialLayout& layout, cv::Size size) {
+    std::vector<cv::Rect> regions;
+    for (const auto& grid : layout.grids) {
+        int cellWidth = size.width / grid.cols;
+        int cellHeight = size.height / grid.rows;
+        for (int r = 0; r < grid.rows; ++r) {
+            for (int c = 0; c < grid.cols; ++c) {
+                regions.push_back(cv::Rect(c * cellWidth, r * cellHeight, cellWidth, cellHeight));
+            }
+        }
+    }
+    return regions;
+}
+
+std::string layoutFeatureType(const SpatialLayout& layout) {
+    return layout.spec == DEFAULT_SPATIAL_LAYOUT ? "rgb-top-bottom" : "rgb-grid:" + layout.spec;
+}
+
+std::string layoutFileSuffix(const SpatialLayout& layout) {
+    if (layout.spec == DEFAULT_SPATIAL_LAYOUT) {
+        return "";
+    }
+    std::string suffix = "_" + layout.spec;
+    std::replace(suffix.begin(), suffix.end(), ':', '_');
+    std::replace(suffix.begin(), suffix.end(), ',', '_');
+    return suffix;
+}
+
+// Sorted, distinct lattice lines clamped to [0, limit]
+static std::vector<int> latticeLines(std::vector<int> edges, int limit) {
+    for (int& edge : edges) {
+        edge = std::min(std::max(edge, 0), limit);
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    return edges;
+}
+
+IntegralHistogram::IntegralHistogram(const cv::Mat& image, int binsPerChannel, std::vector<int> xEdges, std::vector<int> yEdges)
+    : bins_(binsPerChannel * binsPerChannel * binsPerChannel),
+      xEdges_(latticeLines(std::move(xEdges), image.cols)),
+      yEdges_(latticeLines(std::move(yEdges), image.rows)),
+      cumulative_(xEdges_.size() * yEdges_.size() * bins_, 0) {
+    if (xEdges_.size() < 2 || yEdges_.size() < 2 || image.type() != CV_8UC3) {
+        return;
+    }
+
+    // Bin offset of each channel value, so a pixel's bin is three lookups and two adds
+    // (uniform 0-256 bins, blue-major like cv::calcHist with channels {0, 1, 2})
+    int lut[3][256];
+    for (int v = 0; v < 256; ++v) {
+        int bin = v * binsPerChannel / 256;
+        lut[0][v] = bin * binsPerChannel * binsPerChannel;
+        lut[1][v] = bin * binsPerChannel;
+        lut[2][v] = bin;
+    }
+
+    size_t cells = xEdges_.size() - 1;
+    std::vector<uint32_t> bandCounts(cells * bins_);
+    std::vector<uint32_t> running(bins_);
+    for (size_t i = 0; i + 1 < yEdges_.size(); ++i) {
+        // Counts of every lattice cell in the band between lines i and i+1
+        std::fill(bandCounts.begin(), bandCounts.end(), 0);
+        for (int y = yEdges_[i]; y < yEdges_[i + 1]; ++y) {
+            const uchar* row = image.ptr<uchar>(y);
+            for (size_t j = 0; j < cells; ++j) {
+                uint32_t* counts = bandCounts.data() + j * bins_;
+                const uchar* pixel = row + 3 * xEdges_[j];
+                const uchar* end = row + 3 * xEdges_[j + 1];
+                for (; pixel < end; pixel += 3) {
+                    ++counts[lut[0][pixel[0]] + lut[1][pixel[1]] + lut[2][pixel[2]]];
+                }
+            }
+        }
+
+        // Point (i+1, j+1) is the point above it plus the band's cells left of it
+        std::fill(running.begin(), running.end(), 0);
+        for (size_t j = 0; j < cells; ++j) {
+            const uint32_t* above = cumulative(i, j + 1);
+            uint32_t* point = cumulative_.data() + ((i + 1) * xEdges_.size() + j + 1) * bins_;
+            const uint32_t* counts = bandCounts.data() + j * bins_;
+            for (int b = 0; b < bins_; ++b) {
+                running[b] += counts[b];
+                point[b] = above[b] + running[b];
+            }
+        }
+    }
+}
+
+bool IntegralHistogram::regionCounts(const cv::Rect& rect, uint32_t* counts) const {
+    auto line = [](const std::vector<int>& lines, int position) -> long {
+        auto it = std::lower_bound(lines.begin(), lines.end(), position);
+        return it != lines.end() && *it == position ? it - lines.begin() : -1;
+    };
+    long x0 = line(xEdges_, rect.x), x1 = line(xEdges_, rect.x + rect.width);
+    long y0 = line(yEdges_, rect.y), y1 = line(yEdges_, rect.y + rect.height);
+    if (x0 < 0 || x1 < 0 || y0 < 0 || y1 < 0) {
+        return false;
+    }
+
+    const uint32_t* a = cumulative(y0, x0);
+    const uint32_t* b = cumulative(y0, x1);
+    const uint32_t* c = cumulative(y1, x0);
+    const uint32_t* d = cumulative(y1, x1);
+    for (int i = 0; i < bins_; ++i) {
+        counts[i] = d[i] - b[i] - c[i] + a[i];
+    }
+    return true;
+}
+
+bool computeLayoutHistograms(const cv::Mat& image, const SpatialLayout& layout, std::vector<float>& features, int binsPerChannel) {
+    features.clear();
+    if (image.empty() || image.type() != CV_8UC3) {
+        return false;
+    }
+
+    std::vector<cv::Rect> regions = layoutRegions(layout, image.size());
+    std::vector<int> xEdges, yEdges;
+    for (const auto& region : regions) {
+        xEdges.push_back(region.x);
+        xEdges.push_back(region.x + region.width);
+        yEdges.push_back(region.y);
+        yEdges.push_back(region.y + region.height);
+    }
+    IntegralHistogram integral(image, binsPerChannel, xEdges, yEdges);
+
+    std::vector<uint32_t> counts(integral.bins());
+    std::vector<float> histogram(integral.bins());
+    features.reserve(regions.size() * integral.bins());
+    for (const auto& region : regions) {
+        integral.regionCounts(region, counts.data());
+        histogram.assign(counts.begin(), counts.end());
+        cv::normalize(histogram, histogram, 0, 1, cv::NORM_MINMAX);
+        features.insert(features.end(), histogram.begin(), histogram.end());
+    }
+    return true;
+}
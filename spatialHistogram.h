@@ -0,0 +1,82 @@
+/**
+
+spatialHistogram.h
+Project 2
+
+Spatial-layout RGB histograms for Task 3. A layout lists the image regions whose
+histograms make up the feature vector: grids of equal cells and spatial pyramids.
+An integral histogram is built once per image over the lattice formed by the edges
+of every region, so each region's histogram is read with four lookups per bin and
+overlapping regions (a pyramid) do not rescan the pixels.
+
+Layout specs are comma-separated grids:
+  CxR        C columns by R rows of equal cells, e.g. "1x2" (top/bottom halves),
+             "2x2", "3x3", "1x3" (three horizontal bands)
+  pyramid:N  the grids 1x1, 2x2, ... 2^(N-1)x2^(N-1)
+Regions are ordered grid by grid, cells row-major.
+
+**/
+#ifndef SPATIALHISTOGRAM_H
+#define SPATIALHISTOGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Layout of the original top/bottom feature ("rgb-top-bottom")
+#define DEFAULT_SPATIAL_LAYOUT "1x2"
+
+struct LayoutGrid {
+    int cols;
+    int rows;
+};
+
+struct SpatialLayout {
+    std::string spec;
+    std::vector<LayoutGrid> grids;
+};
+
+// Parse a layout spec; returns -1 (and prints the error) if it is malformed
+int parseSpatialLayout(const std::string& spec, SpatialLayout& layout);
+
+// Pixel rectangles of every region of layout in an image of the given size. Cells of a
+// CxR grid are cols/C by rows/R pixels; leftover columns and rows on the right and
+// bottom are not covered, as in the original top/bottom split.
+std::vector<cv::Rect> layoutRegions(const SpatialLayout& layout, cv::Size size);
+
+// Feature type recorded in the store: "rgb-top-bottom" for the default layout, else "rgb-grid:<spec>"
+std::string layoutFeatureType(const SpatialLayout& layout);
+
+// Suffix for the CSV and store file names: empty for the default layout, else "_<spec>" with ':' and ',' replaced
+std::string layoutFileSuffix(const SpatialLayout& layout);
+
+// Cumulative BGR histogram counts of an image over a lattice of pixel positions
+class IntegralHistogram {
+public:
+    // image is CV_8UC3; xEdges and yEdges are the lattice lines (any order, duplicates allowed).
+    // Pixels outside the outermost lines are not counted.
+    IntegralHistogram(const cv::Mat& image, int binsPerChannel, std::vector<int> xEdges, std::vector<int> yEdges);
+
+    // Number of bins of a region histogram (binsPerChannel^3, blue-major as cv::calcHist)
+    int bins() const { return bins_; }
+
+    // Counts of rect, whose edges must lie on the lattice; returns false otherwise
+    bool regionCounts(const cv::Rect& rect, uint32_t* counts) const;
+
+private:
+    const uint32_t* cumulative(size_t row, size_t col) const {
+        return cumulative_.data() + (row * xEdges_.size() + col) * bins_;
+    }
+
+    int bins_;
+    std::vector<int> xEdges_;
+    std::vector<int> yEdges_;
+    std::vector<uint32_t> cumulative_; // (yEdges x xEdges) lattice points, bins_ counts each
+};
+
+// Concatenated histograms of every region of layout, each min-max normalized. With the
+// default layout this is the "rgb-top-bottom" feature. Returns false unless image is CV_8UC3.
+bool computeLayoutHistograms(const cv::Mat& image, const SpatialLayout& layout, std::vector<float>& features, int binsPerChannel = 8);
+
+#endif
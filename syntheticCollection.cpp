@@ -0,0 +1,146 @@
+/**
+
+syntheticCollection.cpp
+Project 2
+
+Drawing and writing of the synthetic benchmark collections.
+
+**/
+
+#include "syntheticCollection.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+#define SYNTHETIC_COLLECTION_VERSION 1
+
+static cv::Scalar randomColor(cv::RNG& rng) {
+    return cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+}
+
+// Shift every channel of color by up to +-spread
+static cv::Scalar jitter(const cv::Scalar& color, cv::RNG& rng, int spread) {
+    cv::Scalar shifted;
+    for (int c = 0; c < 3; ++c) {
+        shifted[c] = std::min(255.0, std::max(0.0, color[c] + rng.uniform(-spread, spread + 1)));
+    }
+    return shifted;
+}
+
+static void drawFace(cv::Mat& image, cv::RNG& rng) {
+    int size = std::min(image.cols, image.rows) / 3;
+    cv::Point center(rng.uniform(size, image.cols - size + 1), rng.uniform(size, image.rows - size + 1));
+    cv::Scalar skin = jitter(cv::Scalar(150, 180, 225), rng, 20);
+    cv::Scalar dark(40, 40, 50);
+
+    cv::ellipse(image, center, cv::Size(size * 3 / 8, size / 2), 0, 0, 360, skin, cv::FILLED, cv::LINE_AA);
+    cv::ellipse(image, center - cv::Point(0, size * 3 / 8), cv::Size(size * 2 / 5, size / 5), 0, 180, 360, dark, cv::FILLED, cv::LINE_AA);
+    for (int side : {-1, 1}) {
+        cv::Point eye = center + cv::Point(side * size / 6, -size / 10);
+        cv::ellipse(image, eye, cv::Size(size / 14, size / 24), 0, 0, 360, dark, cv::FILLED, cv::LINE_AA);
+        cv::line(image, eye - cv::Point(size / 12, size / 10), eye + cv::Point(size / 12, -size / 10), dark, std::max(1, size / 40), cv::LINE_AA);
+    }
+    cv::line(image, center, center + cv::Point(0, size / 8), skin * 0.7, std::max(1, size / 40), cv::LINE_AA);
+    cv::ellipse(image, center + cv::Point(0, size / 5), cv::Size(size / 8, size / 20), 0, 0, 180, cv::Scalar(60, 60, 160), std::max(1, size / 30), cv::LINE_AA);
+}
+
+cv::Mat syntheticImage(const SyntheticCollectionOptions& options, int i) {
+    int scene = options.scenes > 0 ? i % options.scenes : i;
+
+    // The scene generator fixes the palette and layout; the image generator perturbs them
+    cv::RNG sceneRng(options.seed * 1000003ULL + static_cast<uint64_t>(scene));
+    cv::RNG rng(options.seed * 2654435761ULL + static_cast<uint64_t>(i) * 40503ULL + 17);
+
+    cv::Mat image(options.height, options.width, CV_8UC3);
+    cv::Scalar top = jitter(randomColor(sceneRng), rng, 12);
+    cv::Scalar bottom = jitter(randomColor(sceneRng), rng, 12);
+    for (int y = 0; y < image.rows; ++y) {
+        double t = image.rows > 1 ? static_cast<double>(y) / (image.rows - 1) : 0.0;
+        image.row(y).setTo(top * (1.0 - t) + bottom * t);
+    }
+
+    int shapes = sceneRng.uniform(6, 16);
+    for (int s = 0; s < shapes; ++s) {
+        cv::Scalar color = jitter(randomColor(sceneRng), rng, 16);
+        int kind = sceneRng.uniform(0, 3);
+        cv::Point center(static_cast<int>(sceneRng.uniform(0.0, 1.0) * options.width) + rng.uniform(-options.width / 20, options.width / 20 + 1),
+                         static_cast<int>(sceneRng.uniform(0.0, 1.0) * options.height) + rng.uniform(-options.height / 20, options.height / 20 + 1));
+        int extent = static_cast<int>(sceneRng.uniform(0.05, 0.25) * std::min(options.width, options.height)) + 1;
+        if (kind == 0) {
+            cv::rectangle(image, center - cv::Point(extent, extent / 2), center + cv::Point(extent, extent / 2), color, cv::FILLED);
+        } else if (kind == 1) {
+            cv::circle(image, center, extent, color, cv::FILLED, cv::LINE_AA);
+        } else {
+            // Stripes give the texture features some edges to measure
+            for (int k = -extent; k <= extent; k += std::max(2, extent / 6)) {
+                cv::line(image, center + cv::Point(k, -extent), center + cv::Point(k + extent / 2, extent), color, 2, cv::LINE_AA);
+            }
+        }
+    }
+
+    if (options.faceEvery > 0 && i % options.faceEvery == 0) {
+        drawFace(image, rng);
+    }
+
+    cv::Mat noise(image.size(), CV_16SC3);
+    rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(6));
+    cv::Mat noisy;
+    image.convertTo(noisy, CV_16SC3);
+    noisy += noise;
+    noisy.convertTo(image, CV_8UC3);
+    return image;
+}
+
+// One line describing the options, stored next to the images
+static std::string describe(const SyntheticCollectionOptions& options) {
+    std::ostringstream text;
+    text << "version " << SYNTHETIC_COLLECTION_VERSION << " count " << options.count << " size " << options.width << "x"
+         << options.height << " seed " << options.seed << " scenes " << options.scenes << " faceEvery " << options.faceEvery
+         << " quality " << options.jpegQuality;
+    return text.str();
+}
+
+long generateSyntheticCollection(const std::string& directory, const SyntheticCollectionOptions& options) {
+    if (options.count <= 0 || options.width < 16 || options.height < 16) {
+        std::cerr << "Error: A synthetic collection needs at least one image of at least 16x16 pixels" << std::endl;
+        return -1;
+    }
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    std::string descriptionFile = (fs::path(directory) / "synthetic.txt").string();
+    std::string description = describe(options);
+    std::ifstream existing(descriptionFile);
+    std::string line;
+    if (existing && std::getline(existing, line) && line == description) {
+        return options.count;
+    }
+    existing.close();
+    fs::remove(descriptionFile, ec);
+
+    // Images of an earlier, different collection would otherwise be mixed in
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        if (entry.path().extension() == ".jpg" && entry.path().filename().string().rfind("pic.", 0) == 0) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+
+    std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, options.jpegQuality};
+    char filename[32];
+    for (int i = 0; i < options.count; ++i) {
+        std::snprintf(filename, sizeof(filename), "pic.%04d.jpg", i);
+        if (!cv::imwrite((fs::path(directory) / filename).string(), syntheticImage(options, i), params)) {
+            std::cerr << "Error: Unable to write " << filename << " to " << directory << std::endl;
+            return -1;
+        }
+    }
+
+    std::ofstream out(descriptionFile, std::ios::trunc);
+    out << description << "\n";
+    return out ? options.count : -1;
+}
@@ -0,0 +1,39 @@
+/**
+
+syntheticCollection.h
+Project 2
+
+Procedural image collections for benchmarking without the olympus directory. Every
+image is drawn from a seeded cv::RNG, so the same options always give the same
+pixels on any machine: a gradient background, a scene-dependent set of shapes and
+sensor-like noise, plus a cartoon face on a fraction of the images so the face
+detector has something to look at. Images of the same scene share a palette and
+layout, which gives the matchers near neighbours to find.
+
+**/
+#ifndef SYNTHETICCOLLECTION_H
+#define SYNTHETICCOLLECTION_H
+
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+struct SyntheticCollectionOptions {
+    int count = 100;
+    int width = 640;
+    int height = 480;
+    uint64_t seed = 1;
+    int scenes = 10;      // images i and i + scenes share a palette and layout
+    int faceEvery = 4;    // a face on every faceEvery-th image, 0 for none
+    int jpegQuality = 90;
+};
+
+// Image i of the collection described by options (BGR)
+cv::Mat syntheticImage(const SyntheticCollectionOptions& options, int i);
+
+// Write pic.NNNN.jpg for every image into directory, creating it if needed. A directory
+// that already holds the same collection (recorded in synthetic.txt) is left alone.
+// Returns the number of images or -1 on error.
+long generateSyntheticCollection(const std::string& directory, const SyntheticCollectionOptions& options);
+
+#endif
@@ -0,0 +1,85 @@
+/**
+
+topK.h
+Project 2
+
+Bounded top-k selection used by the matchers. Candidates are pushed as (image id,
+score) pairs during the scan and only the best k are kept in a fixed-size heap, so a
+scan costs O(N log k) and filenames are looked up only for the final results.
+
+**/
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct TopKEntry {
+    uint32_t id;
+    float score;
+};
+
+class TopK {
+public:
+    // largerIsBetter selects similarity scores (e.g. histogram intersection) instead of distances
+    explicit TopK(size_t k, bool largerIsBetter = false) : k_(k), largerIsBetter_(largerIsBetter) {
+        heap_.reserve(k);
+    }
+
+    void push(uint32_t id, float score) {
+        if (k_ == 0) {
+            return;
+        }
+        if (heap_.size() < k_) {
+            heap_.push_back({id, score});
+            std::push_heap(heap_.begin(), heap_.end(), worstOnTop());
+        } else if (better(score, heap_.front().score)) {
+            // Replace the current worst entry
+            std::pop_heap(heap_.begin(), heap_.end(), worstOnTop());
+            heap_.back() = {id, score};
+            std::push_heap(heap_.begin(), heap_.end(), worstOnTop());
+        }
+    }
+
+    // Score a candidate has to beat to enter the result; infinite until k entries are held
+    float threshold() const {
+        if (heap_.size() < k_ || k_ == 0) {
+            return largerIsBetter_ ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+        }
+        return heap_.front().score;
+    }
+
+    bool better(float a, float b) const { return largerIsBetter_ ? a > b : a < b; }
+    size_t size() const { return heap_.size(); }
+    size_t k() const { return k_; }
+    bool largerIsBetter() const { return largerIsBetter_; }
+    void clear() { heap_.clear(); }
+
+    // Kept entries, best first
+    std::vector<TopKEntry> sorted() const {
+        std::vector<TopKEntry> result(heap_);
+        std::sort(result.begin(), result.end(), [this](const TopKEntry& a, const TopKEntry& b) {
+            return better(a.score, b.score);
+        });
+        return result;
+    }
+
+private:
+    // Heap ordering that keeps the worst kept entry at the front
+    struct WorstOnTop {
+        bool largerIsBetter;
+        bool operator()(const TopKEntry& a, const TopKEntry& b) const {
+            return largerIsBetter ? a.score > b.score : a.score < b.score;
+        }
+    };
+    WorstOnTop worstOnTop() const { return WorstOnTop{largerIsBetter_}; }
+
+    size_t k_;
+    bool largerIsBetter_;
+    std::vector<TopKEntry> heap_;
+};
+
+#endif